@@ -0,0 +1,93 @@
+#include "vjoy.h"
+#include "vjoy_python.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Force feedback upload stress test: converts a million effects the way
+ * vjoy_group_ff_deliver() does, reads a couple of fields from each like a
+ * module would, and reports per-upload latency and resident memory growth.
+ */
+
+#define BENCH_UPLOADS 1000000
+
+static long bench_rss_kb() {
+    long  pages = 0, resident = 0;
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm != NULL) {
+        if (fscanf(statm, "%ld %ld", &pages, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(statm);
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static long long bench_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int bench_compare(const void *a, const void *b) {
+    long long x = *(const long long*)a, y = *(const long long*)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv) {
+    int uploads = argc > 1 ? atoi(argv[1]) : BENCH_UPLOADS;
+    if (uploads < 1) uploads = 1;
+    long long *samples = malloc(uploads * sizeof(long long));
+    memset(samples, 0, uploads * sizeof(long long)); // Keep it out of the RSS delta
+
+    Py_Initialize();
+    vjoy_py_initialize();
+    PyObject *strong = PyString_FromString("strong_magnitude");
+    PyObject *level  = PyString_FromString("magnitude");
+
+    struct ff_effect effect;
+    long      rss_start = bench_rss_kb();
+    long long total     = bench_now_ns();
+    for (int i=0; i<uploads; i++) {
+        memset(&effect, 0, sizeof(struct ff_effect));
+        effect.id = i % 16;
+        if (i & 1) {
+            effect.type                       = FF_RUMBLE;
+            effect.u.rumble.strong_magnitude  = i & 0xffff;
+            effect.u.rumble.weak_magnitude    = ~i & 0xffff;
+        } else {
+            effect.type                       = FF_PERIODIC;
+            effect.u.periodic.waveform        = FF_SINE;
+            effect.u.periodic.magnitude       = i & 0x7fff;
+        }
+
+        long long start    = bench_now_ns();
+        PyObject *pyeffect = vjoy_convert_ff_effect(&effect);
+        PyObject *part     = PyMapping_GetItemString(pyeffect, (i & 1) ? "rumble" : "periodic");
+        PyObject *value    = PyObject_GetItem(part, (i & 1) ? strong : level);
+        Py_XDECREF(value);
+        Py_XDECREF(part);
+        Py_XDECREF(pyeffect);
+        samples[i] = bench_now_ns() - start;
+        if (PyErr_Occurred() != NULL) {
+            PyErr_Print();
+            return 1;
+        }
+    }
+    total = bench_now_ns() - total;
+    long rss_end = bench_rss_kb();
+
+    qsort(samples, uploads, sizeof(long long), bench_compare);
+    printf("uploads:        %i\n", uploads);
+    printf("mean:           %.1f ns/upload\n", (double)total / uploads);
+    printf("p50/p99/p99.9:  %lld / %lld / %lld ns\n", samples[uploads/2],
+           samples[(long long)uploads*99/100], samples[(long long)uploads*999/1000]);
+    printf("rss:            %ld kB -> %ld kB (%+ld kB)\n", rss_start, rss_end, rss_end - rss_start);
+
+    Py_DECREF(strong);
+    Py_DECREF(level);
+    free(samples);
+    return 0;
+}
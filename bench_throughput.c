@@ -0,0 +1,105 @@
+#include "vjoy.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Throughput benchmark: loads N copies of benchjoy.py on the null backend
+ * and ticks them back to back through the full think -> parse -> emit ->
+ * flush path, with no reactors or timers in the way.  Reports events per
+ * second, per-tick latency percentiles and malloc() calls per tick.
+ *
+ *     VJOYPATH=. ./vjoy_bench_throughput [devices] [ticks] [module]
+ */
+
+#define BENCH_DEVICES 4
+#define BENCH_TICKS   100000
+
+// Count every libc allocation; Python's small object allocator only shows
+// up when it needs a new arena, so this is what reaches the system heap.
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static unsigned long bench_mallocs = 0;
+
+void *malloc(size_t size) {
+    bench_mallocs++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    bench_mallocs++;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    bench_mallocs++;
+    return __libc_realloc(ptr, size);
+}
+
+int main(int argc, char **argv) {
+    int   count  = argc > 1 ? atoi(argv[1]) : BENCH_DEVICES;
+    int   ticks  = argc > 2 ? atoi(argv[2]) : BENCH_TICKS;
+    char *module = argc > 3 ? argv[3] : "benchjoy";
+    if (count < 1) count = 1;
+    if (count > VJOY_MAX_DEVICES) count = VJOY_MAX_DEVICES;
+    if (ticks < 1) ticks = 1;
+
+    vjoy_log_threshold = VJOY_LOG_WARN;
+    setenv("VJOYPATH", ".", 0);
+    vjoy_backend_select("null");
+    if (vjoy_initialize(0) < 0) {
+        return 1;
+    }
+    vjoy_dev **devs = malloc(count * sizeof(vjoy_dev*));
+    for (int i=0; i<count; i++) {
+        if (vjoy_load_module(module) < 0) {
+            fprintf(stderr, "Failed to load module: %s\n", module);
+            return 1;
+        }
+        devs[i] = vjoy_get_device(i);
+    }
+
+    // Warm up caches and let the modules settle before measuring
+    for (int t=0; t<ticks/100; t++) {
+        for (int i=0; i<count; i++) {
+            vjoy_dev_think(devs[i]);
+        }
+    }
+
+    vjoy_hist          latency;
+    unsigned long      events  = 0, staged = 0;
+    memset(&latency, 0, sizeof(vjoy_hist));
+    for (int i=0; i<count; i++) {
+        events -= devs[i]->stats.eventsout;
+        staged -= devs[i]->stats.eventsout + devs[i]->suppressed + devs[i]->emptyframes;
+    }
+    unsigned long      mallocs = bench_mallocs;
+    unsigned long long total   = vjoy_stats_now();
+    for (int t=0; t<ticks; t++) {
+        for (int i=0; i<count; i++) {
+            unsigned long long start = vjoy_stats_now();
+            vjoy_dev_think(devs[i]);
+            vjoy_hist_record(&latency, vjoy_stats_now() - start);
+        }
+    }
+    total   = vjoy_stats_now() - total;
+    mallocs = bench_mallocs - mallocs;
+    for (int i=0; i<count; i++) {
+        events += devs[i]->stats.eventsout;
+        staged += devs[i]->stats.eventsout + devs[i]->suppressed + devs[i]->emptyframes;
+    }
+
+    double seconds = total / 1e9;
+    double calls   = (double)ticks * count;
+    printf("devices:        %i x %s\n", count, module);
+    printf("ticks:          %i per device in %.3f s\n", ticks, seconds);
+    printf("events:         %.0f written/s, %.0f staged/s\n", events / seconds, staged / seconds);
+    printf("tick:           %.0f ns mean\n", total / calls);
+    printf("p50/p99/p99.9:  %llu / %llu / %llu ns\n", vjoy_hist_quantile(&latency, 0.5),
+           vjoy_hist_quantile(&latency, 0.99), vjoy_hist_quantile(&latency, 0.999));
+    printf("max:            %llu ns\n", latency.max);
+    printf("mallocs:        %.2f per tick\n", mallocs / calls);
+    return 0;
+}
@@ -0,0 +1,39 @@
+import vjoy, math
+
+# Synthetic load for bench_throughput: example.py's circling stick plus a
+# throttle, a hat and a few buttons, all returned as an event list so the
+# whole think -> parse -> emit path is exercised every tick.
+def getVJoyInfo():
+	return {
+		'name':       'vjoy benchmark',
+		'relaxis':    [],
+		'absaxis':    [vjoy.ABS_X, vjoy.ABS_Y, vjoy.ABS_THROTTLE, vjoy.ABS_HAT0X],
+		'feedback':   [],
+		'maxeffects': 0,
+		'buttons':    [vjoy.BTN_TRIGGER, vjoy.BTN_THUMB, vjoy.BTN_THUMB2, vjoy.BTN_TOP],
+		'rate':       1000
+	}
+
+theta = 0.0
+tick  = 0
+def doVJoyThink():
+    global theta, tick
+    theta += 0.05
+    tick  += 1
+    events = []
+    events.append([vjoy.EV_ABS, vjoy.ABS_X, int(math.cos(theta) * 32500)])
+    events.append([vjoy.EV_ABS, vjoy.ABS_Y, int(math.sin(theta) * 32500)])
+    events.append([vjoy.EV_ABS, vjoy.ABS_THROTTLE, (tick * 64) % 65536 - 32768])
+    events.append([vjoy.EV_ABS, vjoy.ABS_HAT0X, (tick / 30) % 3 - 1])
+    events.append([vjoy.EV_KEY, vjoy.BTN_TRIGGER, (tick / 10) & 1])
+    events.append([vjoy.EV_KEY, vjoy.BTN_THUMB, (tick / 25) & 1])
+    return events
+
+def doVJoyUploadFeedback(effect):
+    pass
+
+def doVJoyEraseFeedback(effectid):
+    pass
+
+def doVJoyEvent(evtype, evcode, evvalue):
+    pass
@@ -1,2 +1,6 @@
 #! /bin/sh
-gcc -std=c99 `python-config --includes` `python-config --libs` -o vjoy main.c vjoy.c vjoy_python.c
+gcc -std=c99 -O2 `python-config --includes` -o vjoy main.c vjoy.c vjoy_python.c vjoy_ff.c vjoy_log.c vjoy_stats.c vjoy_backend.c vjoy_capture.c vjoy_transform.c vjoy_reload.c vjoy_pool.c vjoy_control.c vjoy_shm.c vjoy_source.c `python-config --libs` -lrt
+# Force feedback upload stress benchmark
+gcc -std=c99 -O2 `python-config --includes` -o vjoy_bench_ff bench_ff.c vjoy.c vjoy_python.c vjoy_ff.c vjoy_log.c vjoy_stats.c vjoy_backend.c vjoy_capture.c vjoy_transform.c vjoy_reload.c vjoy_pool.c vjoy_control.c vjoy_shm.c vjoy_source.c `python-config --libs` -lrt
+# Think/emit throughput benchmark on the null backend, run as VJOYPATH=. ./vjoy_bench_throughput
+gcc -std=c99 -O2 `python-config --includes` -o vjoy_bench_throughput bench_throughput.c vjoy.c vjoy_python.c vjoy_ff.c vjoy_log.c vjoy_stats.c vjoy_backend.c vjoy_capture.c vjoy_transform.c vjoy_reload.c vjoy_pool.c vjoy_control.c vjoy_shm.c vjoy_source.c `python-config --libs` -lrt
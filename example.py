@@ -6,14 +6,59 @@ def getVJoyInfo():
 		'name':       '', # The name of the virtual joystick
 		'relaxis':    [], # List of relative axises to use
 		'absaxis':    [vjoy.ABS_X, vjoy.ABS_Y], # List of absolute axises to use
+		# Optional per axis 'min', 'max', 'fuzz', 'flat' and 'resolution';
+		# axes left out range over -32768..32767
+		'absinfo':    {vjoy.ABS_X: {'min': -32767, 'max': 32767, 'flat': 512}},
 		'feedback':   [vjoy.FF_RUMBLE], # List of force feedback types to support
 		'maxeffects': 4, # Maximum number of concurrent feedback effects 
-		'buttons':    []  # List of buttons to use
+		'buttons':    [], # List of buttons to use
+		'rate':       60, # How many times per second doVJoyThink() runs
+		'catchup':    'skip', # Missed ticks after a slow think: 'skip' or 'burst'
+		'fds':        [], # Descriptors (or objects with fileno()) that wake doVJoyRead()
+		# Native processing of samples fed with vjoy.set_raw(VJoyID, [...]).
+		# Each entry reads raw channel 'input' and drives one 'axis', 'hat'
+		# or 'button'.  Axes and hats take 'in'/'out' (low, high) ranges,
+		# 'deadzone' (fraction), 'expo' (0..1) or a 'curve' of output points
+		# in -1..1 (a 'curve' overrides 'expo'), 'invert' and, for hats, a
+		# 'threshold'.  Buttons take the 'bit' to test and 'invert'.  'out'
+		# defaults to the axis' absinfo.
+		'transforms': [],
+		# True (or a name for shm_open()) to also take input from another
+		# process through shared memory, see vjoy_shm.h.  Its axes, buttons
+		# and queued events go straight into the frame; a module fed only
+		# this way can leave out doVJoyThink().
+		'shm':        False,
+		# Physical evdev devices read and remapped natively, without a trip
+		# through Python.  'grab' keeps their events from everyone else,
+		# codes both devices declare pass through unchanged unless
+		# 'passthrough' is False, and 'map' adds [type, code, type, code]
+		# remappings (absolute axes are rescaled between the two ranges, an
+		# axis mapped to a key presses it past the middle of its range and
+		# a key mapped to an axis sends its maximum or minimum).
+		# Events listed in 'subscribe' also reach doVJoySourceEvent().
+		# 'device' picks the group device it feeds.  With 'ffforward' the
+		# force feedback games send to that device is relayed to the
+		# physical one, scaled by 'ffscale' (a factor, or a dict of them
+		# by effect type, e.g. {vjoy.FF_RUMBLE: 0.5}).
+		'sources':    [] # [{'path': '/dev/input/by-id/...-event-joystick', 'grab': True,
+		              #   'map': [[vjoy.EV_ABS, vjoy.ABS_RZ, vjoy.EV_ABS, vjoy.ABS_RX]],
+		              #   'subscribe': [[vjoy.EV_KEY, vjoy.BTN_MODE]], 'ffforward': True}]
+		# To drive several devices from this one module, list a dict of the
+		# capability keys above (name through buttons, absinfo, transforms, shm)
+		# per device under 'devices'.  They tick together, share one
+		# timestamp and get the ids in VJoyIDs.  doVJoyThink() tags events
+		# for devices other than the first as [index, type, code, value]
+		# and the remaining callbacks get the index as an extra argument.
+		# 'devices':  [{'name': 'Pad 1', ...}, {'name': 'Pad 2', ...}]
 	}
 
 # The "think" routine runs every few milliseconds.  Do NOT perform
 # blocking operations within this function.  Doing so will prevent other
 # important stuff from happening.
+# Events can either be returned as a list of [type, code, value] lists, as
+# any buffer of packed records (e.g. struct.pack(vjoy.EVENT_FORMAT, ...) or
+# array.array('h', [type, code, value, ...])), or staged directly with vjoy.send_event(), vjoy.set_axis(), vjoy.set_buttons()
+# and vjoy.syn(), passing the VJoyID that vjoy assigns to this module.
 theta = 0.0
 def doVJoyThink():
     global theta
@@ -25,7 +70,34 @@ def doVJoyThink():
     events.append([vjoy.EV_ABS, vjoy.ABS_Y, y])
     return events
 
-# Handle force feedback effect uploads.
+# doVJoyThink() may also be a generator.  vjoy then resumes it instead of
+# calling it, until it returns.  Yielding events (or nothing) sends a frame
+# and resumes at the next tick; yielding vjoy.sleep(seconds),
+# vjoy.until(vjoy.now() + seconds) or vjoy.wait_fd(fd[, timeout]) resumes
+# it only then.  Ticks in between only do vjoy's own work ('shm',
+# 'transforms', force feedback), if any.  After wait_fd() the yield
+# evaluates to True if fd became readable and False if it timed out.
+# A generator needs a 'rate' to be started, e.g.:
+#
+# def doVJoyThink():
+#     while True:
+#         vjoy.set_buttons(VJoyID, 1)
+#         yield vjoy.sleep(0.1)
+#         vjoy.set_buttons(VJoyID, 0)
+#         yield vjoy.wait_fd(trigger, 5.0)
+
+# Called as soon as one of the 'fds' (or one passed to vjoy.watch_fd(VJoyID,
+# fd)) is readable, and may return events like doVJoyThink().  Read without
+# blocking.  With 'rate': 0 a module runs on its descriptors alone.
+def doVJoyRead(fd):
+    pass
+
+# Handle force feedback effect uploads.  vjoy also plays uploaded effects
+# itself; vjoy.get_force(VJoyID) returns their mixed (x, y, strong, weak)
+# output for the current tick, or as of the doVJoyRead() or
+# doVJoySourceEvent() call it is made from.  The game's upload has already been answered
+# by then: uploads and erasures are passed on in order just before the next
+# doVJoyThink(), so a slow handler here never stalls the game.
 def doVJoyUploadFeedback(effect):
     print "Feedback Upload:"
     print "\tID:", effect['id']
@@ -37,6 +109,16 @@ def doVJoyEraseFeedback(effectid):
     print "Feedback Erase:"
     print "\tID:", effectid
 
-# Handle miscellaneous input events.  You probably won't need this.
-def doVJoyEvent(evtype, evcode, evvalue):
+# Called for the events a source 'subscribe's to, with the source's index
+# in 'sources', after they were remapped.  It may return events like
+# doVJoyThink(), which go out in the same frame.
+def doVJoySourceEvent(source, evtype, evcode, evvalue):
+    pass
+
+# Handle miscellaneous input events (LEDs, feedback playback and gain).
+# You probably won't need this.  Each SYN_REPORT-terminated group arrives
+# as one buffer of vjoy.EVENT_FORMAT records, e.g. for
+# struct.unpack_from(vjoy.EVENT_FORMAT, batch, offset).  Modules defining
+# only doVJoyEvent(evtype, evcode, evvalue) get one call per event instead.
+def doVJoyEvents(batch):
     pass
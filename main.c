@@ -1,12 +1,126 @@
 #include "vjoy.h"
+#include "vjoy_capture.h"
+#include "vjoy_reload.h"
+#include "vjoy_pool.h"
+#include "vjoy_control.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-v] [-q] [-n] [-t threads] [-s socket] [-C socket] [-b backend] [-c dir]\n", prog);
+    fprintf(stderr, "          [-p module:N ...] [module...]\n");
+    fprintf(stderr, "       %s [-v] [-q] [-b backend] [-o seconds] -r capture [-r capture...]\n", prog);
+    fprintf(stderr, "\t-t threads\tNumber of reactor threads serving devices (default 1)\n");
+    fprintf(stderr, "\t-s socket\tServe stats on this Unix socket, \"\" to disable\n");
+    fprintf(stderr, "\t\t\t(default $XDG_RUNTIME_DIR/vjoy.stats, also dumped on SIGUSR1)\n");
+    fprintf(stderr, "\t-C socket\tAccept load/unload/list/stats/pool commands on this Unix\n");
+    fprintf(stderr, "\t\t\tsocket, \"\" to disable (default $XDG_RUNTIME_DIR/vjoy.control)\n");
+    fprintf(stderr, "\t-p module:N\tKeep N devices like module's created ahead of time\n");
+    fprintf(stderr, "\t-b backend\tuinput (default), null or file:DIR, also read from $VJOY_BACKEND\n");
+    fprintf(stderr, "\t-c dir\t\tCapture every device's frames to dir/vjoy<id>[-<n>].vjcap\n");
+    fprintf(stderr, "\t-r capture\tReplay a capture without loading any module\n");
+    fprintf(stderr, "\t-o seconds\tStart replaying this far into the captures\n");
+    fprintf(stderr, "\t-n\t\tDo not reload modules when they change\n");
+    fprintf(stderr, "\t-v\t\tLog every event (debug output)\n");
+    fprintf(stderr, "\t-q\t\tOnly log errors\n");
+}
 
 int main(int argc, char **argv) {
-    assert(vjoy_initialize() == 0);
-    for (int i=1; i<argc; i++) {
+    int            threads     = 1;
+    vjoy_log_level level       = VJOY_LOG_INFO;
+    const char    *statspath   = NULL;
+    const char    *controlpath = NULL;
+    char         **pools       = calloc(argc, sizeof(char*));
+    int            poolcount   = 0;
+    const char    *backend     = getenv("VJOY_BACKEND");
+    const char    *capture     = NULL;
+    char         **replays     = calloc(argc, sizeof(char*));
+    int            replaycount = 0;
+    double         offset      = 0;
+    int            reload      = 1;
+    int            opt;
+    while ((opt = getopt(argc, argv, "t:s:C:p:b:c:r:o:nvqh")) != -1) {
+        switch (opt) {
+            case 't':
+                threads = atoi(optarg);
+                break;
+            case 'b':
+                backend = optarg;
+                break;
+            case 's':
+                statspath = optarg;
+                break;
+            case 'C':
+                controlpath = optarg;
+                break;
+            case 'p':
+                pools[poolcount++] = optarg;
+                break;
+            case 'c':
+                capture = optarg;
+                break;
+            case 'r':
+                replays[replaycount++] = optarg;
+                break;
+            case 'o':
+                offset = atof(optarg);
+                break;
+            case 'n':
+                reload = 0;
+                break;
+            case 'v':
+                level = VJOY_LOG_DEBUG;
+                break;
+            case 'q':
+                level = VJOY_LOG_ERROR;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    vjoy_log_threshold = level;
+    if (backend != NULL && vjoy_backend_select(backend) < 0) {
+        return 1;
+    }
+    // Replays stream straight from C, Python is never started
+    if (replaycount > 0) {
+        vjoy_log_start(level);
+        return vjoy_replay(replays, replaycount, offset) < 0 ? 1 : 0;
+    }
+
+    // Before any thread exists, so they all inherit the signal mask
+    sigset_t stop;
+    sigemptyset(&stop);
+    sigaddset(&stop, SIGINT);
+    sigaddset(&stop, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop, NULL);
+    vjoy_stats_start(statspath);
+    vjoy_log_start(level);
+    if (capture != NULL) {
+        vjoy_capture_start(capture);
+    }
+    if (threads < 1) threads = 1;
+    assert(vjoy_initialize(threads) == 0);
+    for (int i=optind; i<argc; i++) {
         if (vjoy_load_module(argv[i]) < 0) {
-            printf("Failed to load module: %s\n", argv[i]);
+            vjoy_log(VJOY_LOG_ERROR, "Failed to load module: %s", argv[i]);
 	}
     }
-    sleep(36000);
+    for (int i=0; i<poolcount; i++) {
+        vjoy_pool_add(pools[i]);
+    }
+    vjoy_control_start(controlpath);
+    if (reload) {
+        char dir[4096];
+        snprintf(dir, sizeof(dir), "%s/.config/vjoy/modules", getenv("HOME"));
+        vjoy_reload_start(dir);
+    }
+    int sig;
+    sigwait(&stop, &sig);
+    vjoy_log(VJOY_LOG_INFO, "Shutting down.");
+    vjoy_shutdown();
     return 0;
 }
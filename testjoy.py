@@ -17,7 +17,23 @@ B_UP       = 0x0D
 B_LEFT     = 0x0E
 B_RIGHT    = 0x0F
 
-sdata = serial.Serial('/dev/ttyUSB0', 115200)
+# Non-blocking; vjoy wakes doVJoyRead() as soon as the pad answers
+sdata   = serial.Serial('/dev/ttyUSB0', 115200, timeout=0)
+pending = ''
+waiting = 0
+
+# Raw channels fed to vjoy.set_raw(), straight from the pad's packet
+R_BUTTONS = 0
+R_LEFT_Y  = 1
+R_LEFT_X  = 2
+R_RIGHT_Y = 3
+R_RIGHT_X = 4
+
+def stick(channel, axis):
+	return {'input': channel, 'axis': axis, 'in': [0, 1023]}
+
+def button(bit, code):
+	return {'input': R_BUTTONS, 'bit': bit, 'button': code}
 
 def getVJoyInfo():
 	return {
@@ -30,55 +46,54 @@ def getVJoyInfo():
 		             vjoy.BTN_X,      vjoy.BTN_Y,     vjoy.BTN_TL,
 		             vjoy.BTN_TR,     vjoy.BTN_TL2,   vjoy.BTN_TR2,
 		             vjoy.BTN_SELECT, vjoy.BTN_START, vjoy.BTN_THUMBL,
-		             vjoy.BTN_THUMBR]
+		             vjoy.BTN_THUMBR],
+		'fds':      [sdata],
+		'rate':     10, # Only to re-poll a pad that stopped answering
+		# Scaling and bit tests run natively on the raw samples
+		'transforms': [
+			stick(R_RIGHT_X, vjoy.ABS_RX),
+			stick(R_RIGHT_Y, vjoy.ABS_RY),
+			stick(R_LEFT_X,  vjoy.ABS_X),
+			stick(R_LEFT_Y,  vjoy.ABS_Y),
+			button(B_SQUARE,   vjoy.BTN_X),
+			button(B_TRIANGLE, vjoy.BTN_Y),
+			button(B_CROSS,    vjoy.BTN_A),
+			button(B_CIRCLE,   vjoy.BTN_B),
+			button(B_LEFT,     vjoy.KEY_LEFT),
+			button(B_RIGHT,    vjoy.KEY_RIGHT),
+			button(B_UP,       vjoy.KEY_UP),
+			button(B_DOWN,     vjoy.KEY_DOWN),
+			button(B_START,    vjoy.BTN_START),
+			button(B_SELECT,   vjoy.BTN_SELECT),
+			button(B_L1,       vjoy.BTN_TL),
+			button(B_R1,       vjoy.BTN_TR),
+			button(B_L2,       vjoy.BTN_TL2),
+			button(B_R2,       vjoy.BTN_TR2),
+			button(B_L3,       vjoy.BTN_THUMBL),
+			button(B_R3,       vjoy.BTN_THUMBR)
+		]
 	}
 
-def remap(x):
-	x = (x-512)*64
-	if x > 32767:
-		x = 32767
-	elif x < -32768:
-		x = -32768
-	return x
-
-def checkBtn(buttons, code):
-	if (buttons & (1 << code)) > 0:
-		return True
-	return False
-
-def doVJoyThink():
+def poll():
+	global pending, waiting
 	sdata.flushInput()
 	sdata.write('\x01')
-	data = sdata.read(10)
-	buttons, joy_l_y, joy_l_x, joy_r_y, joy_r_x = struct.unpack('<HHHHH', data)
-
-	vjoy.send_event(VJoyID, vjoy.EV_ABS, vjoy.ABS_RX,     remap(joy_r_x))
-	vjoy.send_event(VJoyID, vjoy.EV_ABS, vjoy.ABS_RY,     remap(joy_r_y))
-	vjoy.send_event(VJoyID, vjoy.EV_ABS, vjoy.ABS_X,      remap(joy_l_x))
-	vjoy.send_event(VJoyID, vjoy.EV_ABS, vjoy.ABS_Y,      remap(joy_l_y))
-
-	vjoy.send_event(VJoyID, vjoy.EV_KEY, vjoy.BTN_X,      checkBtn(buttons, B_SQUARE))
-	vjoy.send_event(VJoyID, vjoy.EV_KEY, vjoy.BTN_Y,      checkBtn(buttons, B_TRIANGLE))
-	vjoy.send_event(VJoyID, vjoy.EV_KEY, vjoy.BTN_A,      checkBtn(buttons, B_CROSS))
-	vjoy.send_event(VJoyID, vjoy.EV_KEY, vjoy.BTN_B,      checkBtn(buttons, B_CIRCLE))
-	vjoy.send_event(VJoyID, vjoy.EV_KEY, vjoy.KEY_LEFT,   checkBtn(buttons, B_LEFT))
-	vjoy.send_event(VJoyID, vjoy.EV_KEY, vjoy.KEY_RIGHT,  checkBtn(buttons, B_RIGHT))
-	vjoy.send_event(VJoyID, vjoy.EV_KEY, vjoy.KEY_UP,     checkBtn(buttons, B_UP))
-	vjoy.send_event(VJoyID, vjoy.EV_KEY, vjoy.KEY_DOWN,   checkBtn(buttons, B_DOWN))
-	vjoy.send_event(VJoyID, vjoy.EV_KEY, vjoy.BTN_START,  checkBtn(buttons, B_START))
-	vjoy.send_event(VJoyID, vjoy.EV_KEY, vjoy.BTN_SELECT, checkBtn(buttons, B_SELECT))
-	vjoy.send_event(VJoyID, vjoy.EV_KEY, vjoy.BTN_TL,     checkBtn(buttons, B_L1))
-	vjoy.send_event(VJoyID, vjoy.EV_KEY, vjoy.BTN_TR,     checkBtn(buttons, B_R1))
-	vjoy.send_event(VJoyID, vjoy.EV_KEY, vjoy.BTN_TL2,    checkBtn(buttons, B_L2))
-	vjoy.send_event(VJoyID, vjoy.EV_KEY, vjoy.BTN_TR2,    checkBtn(buttons, B_R2))
-	vjoy.send_event(VJoyID, vjoy.EV_KEY, vjoy.BTN_THUMBL, checkBtn(buttons, B_L3))
-	vjoy.send_event(VJoyID, vjoy.EV_KEY, vjoy.BTN_THUMBR, checkBtn(buttons, B_R3))
-
-
-
-
-
-
-
+	pending = ''
+	waiting = 0
 
+poll()
 
+def doVJoyThink():
+	global waiting
+	waiting += 1
+	if waiting > 1:
+		poll()
+
+def doVJoyRead(fd):
+	global pending
+	pending += sdata.read(sdata.inWaiting())
+	if len(pending) < 10:
+		return
+	data = pending[:10]
+	poll()
+	vjoy.set_raw(VJoyID, struct.unpack('<HHHHH', data))
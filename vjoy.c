@@ -1,22 +1,35 @@
+#include "vjoy.h"
+#include "vjoy_python.h"
+#include "vjoy_capture.h"
+#include "vjoy_reload.h"
+#include "vjoy_pool.h"
+#include "vjoy_shm.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
+#include <stdint.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <assert.h>
-#include "vjoy.h"
-#include "vjoy_python.h"
+#include <errno.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/timerfd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 
 
 /* globals */
-static const char *uinputpaths[] = {
-    "/dev/uinput",
-    "/dev/misc/uinput",
-    "/dev/input/uinput"
-};
-static vjoy_dev      **devices  = NULL; // List of devices
-static int             devcount = 0;    // Number of devices currently loaded
-static pthread_mutex_t pymutex;         // Global Python threading mutex
+static vjoy_dev       *devices[VJOY_MAX_DEVICES]; // Devices indexed by VJoyID
+static unsigned char   reserved[VJOY_MAX_DEVICES]; // Ids of devices still being created
+static pthread_mutex_t devlock = PTHREAD_MUTEX_INITIALIZER; // Serializes loads, unloads and reloads
+static PyThreadState  *mainstate = NULL; // Main interpreter, parked between loads
+static char            modulepath[4096]; // sys.path given to every interpreter
+static vjoy_reactor    reactors[VJOY_REACTOR_MAX]; // Threads multiplexing devices
+static int             reactorcount = 0;
+
+static void vjoy_dev_flush(vjoy_dev *dev);
 
 static void vjoy_parse_block(PyObject* info, char* key, int *count,
                              int *array, int max) {
@@ -37,20 +50,78 @@ static void vjoy_parse_block(PyObject* info, char* key, int *count,
     }
 }
 
-static void vjoy_parse_info(vjoy_dev *dev) {
-    memset(&dev->devinfo, 0, sizeof(vjoy_info));
-
-    pthread_mutex_lock(&pymutex);
-
-    // Get info
-    PyObject *pyinfo   = PyObject_CallMethod(dev->pymodule, "getVJoyInfo", NULL);
+// Optional integer from a dict in getVJoyInfo(), def when absent
+static int vjoy_parse_int(PyObject* map, char* key, int def) {
+    PyObject *item = PyMapping_GetItemString(map, key);
+    if (item == NULL) {
+        PyErr_Clear();
+        return def;
+    }
+    int value = PyInt_AsLong(item);
+    Py_DECREF(item);
     if (PyErr_Occurred() != NULL) {
-        PyErr_Print();
+        PyErr_Clear();
+        vjoy_log(VJOY_LOG_WARN, "Ignoring '%s', it must be an integer.", key);
+        return def;
     }
-    if (pyinfo == NULL) {
-        fprintf(stderr, "Module has no getVJoyInfo() method.\n");
+    return value;
+}
+
+/* Per axis ranges: 'absinfo' maps axis codes to dicts of min, max, fuzz,
+ * flat and resolution.  Axes left out span SHRT_MIN..SHRT_MAX.
+ */
+static void vjoy_parse_absinfo(vjoy_dev *dev, PyObject* pyinfo) {
+    for (int i=0; i<ABS_CNT; i++) {
+        memset(&dev->devinfo.absinfo[i], 0, sizeof(struct input_absinfo));
+        dev->devinfo.absinfo[i].minimum = SHRT_MIN;
+        dev->devinfo.absinfo[i].maximum = SHRT_MAX;
+    }
+    PyObject *pyabsinfo = PyMapping_GetItemString(pyinfo, "absinfo");
+    if (pyabsinfo == NULL) {
+        PyErr_Clear();
         return;
     }
+    PyObject *pycodes = PyMapping_Keys(pyabsinfo);
+    int       count   = pycodes != NULL ? PySequence_Size(pycodes) : -1;
+    if (count < 0) {
+        vjoy_log(VJOY_LOG_WARN, "'absinfo' must map axis codes to dicts.");
+    }
+    for (int i=0; i<count; i++) {
+        PyObject *pycode = PySequence_GetItem(pycodes, i);
+        PyObject *pyaxis = pycode != NULL ? PyObject_GetItem(pyabsinfo, pycode) : NULL;
+        int       code   = pycode != NULL ? PyInt_AsLong(pycode) : -1;
+        if (code < 0 || code >= ABS_CNT || pyaxis == NULL || !PyMapping_Check(pyaxis)) {
+            vjoy_log(VJOY_LOG_WARN, "Ignoring 'absinfo' entry %i, expected axis code: {...}.", i);
+        } else {
+            struct input_absinfo *abs = &dev->devinfo.absinfo[code];
+            abs->minimum    = vjoy_parse_int(pyaxis, "min", abs->minimum);
+            abs->maximum    = vjoy_parse_int(pyaxis, "max", abs->maximum);
+            abs->fuzz       = vjoy_parse_int(pyaxis, "fuzz", 0);
+            abs->flat       = vjoy_parse_int(pyaxis, "flat", 0);
+            abs->resolution = vjoy_parse_int(pyaxis, "resolution", 0);
+            if (abs->minimum >= abs->maximum) {
+                vjoy_log(VJOY_LOG_WARN, "Axis %x has an empty range, using the default.", code);
+                abs->minimum = SHRT_MIN;
+                abs->maximum = SHRT_MAX;
+            }
+            // Axes rest at 0, or at their minimum if the range does not include it
+            if (abs->minimum > 0 || abs->maximum < 0) {
+                abs->value = abs->minimum;
+            }
+        }
+        PyErr_Clear();
+        Py_XDECREF(pyaxis);
+        Py_XDECREF(pycode);
+    }
+    PyErr_Clear();
+    Py_XDECREF(pycodes);
+    Py_DECREF(pyabsinfo);
+}
+
+// Capabilities of one device, from getVJoyInfo() or one of its 'devices'
+static void vjoy_parse_caps(vjoy_dev *dev, PyObject *pyinfo) {
+    memset(&dev->devinfo, 0, sizeof(vjoy_info));
+    memset(&dev->transform, 0, sizeof(vjoy_transform));
     // Joystick name
     PyObject *pyname = PyMapping_GetItemString(pyinfo, "name");
     if (pyname != NULL) {
@@ -68,6 +139,8 @@ static void vjoy_parse_info(vjoy_dev *dev) {
     // Absolute axises
     vjoy_parse_block(pyinfo, "absaxis", &dev->devinfo.absaxiscount,
                      dev->devinfo.absaxis, ABS_CNT);
+    PyErr_Clear();
+    vjoy_parse_absinfo(dev, pyinfo);
     // Force Feedback effects
     vjoy_parse_block(pyinfo, "feedback", &dev->devinfo.feedbackcount,
                      dev->devinfo.feedback, FF_CNT);
@@ -79,316 +152,1794 @@ static void vjoy_parse_info(vjoy_dev *dev) {
     // Buttons and keys
     vjoy_parse_block(pyinfo, "buttons", &dev->devinfo.buttoncount,
                      dev->devinfo.buttons, KEY_CNT);
+    PyErr_Clear();
+    // Native processing of raw samples fed through vjoy.set_raw()
+    PyObject *pytransforms = PyMapping_GetItemString(pyinfo, "transforms");
+    if (pytransforms != NULL) {
+        vjoy_transform_parse(&dev->transform, &dev->devinfo, pytransforms);
+        vjoy_log(VJOY_LOG_INFO, "\tTransforms: %i axes/hats, %i buttons",
+                 dev->transform.axiscount, dev->transform.bitcount);
+        Py_DECREF(pytransforms);
+    }
+    PyErr_Clear();
+    // Shared memory input: True for the default region name, or a name
+    PyObject *pyshm = PyMapping_GetItemString(pyinfo, "shm");
+    if (pyshm != NULL && PyString_Check(pyshm)) {
+        snprintf(dev->devinfo.shmname, sizeof(dev->devinfo.shmname), "%s%s",
+                 PyString_AS_STRING(pyshm)[0] == '/' ? "" : "/", PyString_AS_STRING(pyshm));
+    } else if (pyshm != NULL && PyObject_IsTrue(pyshm) == 1) {
+        vjoy_shm_name(dev->devinfo.shmname, sizeof(dev->devinfo.shmname), dev->id);
+    }
+    Py_XDECREF(pyshm);
+    PyErr_Clear();
+}
+
+/* Read device info from the Python module.  A module driving several
+ * devices lists their capabilities under 'devices', the first describing
+ * dev itself; the rest of that list is returned for vjoy_load_members().
+ * Scheduling keys ('rate', 'catchup', 'fds') and 'sources' always apply
+ * to the module.
+ */
+static PyObject *vjoy_parse_info(vjoy_dev *dev) {
+    PyObject *pymembers = NULL;
+    memset(&dev->devinfo, 0, sizeof(vjoy_info));
+
+    vjoy_py_enter(dev);
+
+    // Get info
+    PyObject *pyinfo   = PyObject_CallMethod(dev->pymodule, "getVJoyInfo", NULL);
+    if (PyErr_Occurred() != NULL) {
+        vjoy_py_log_error();
+    }
+    if (pyinfo == NULL) {
+        vjoy_log(VJOY_LOG_ERROR, "Module has no getVJoyInfo() method.");
+        vjoy_py_leave(dev);
+        return NULL;
+    }
+    PyObject *pydevices = PyMapping_GetItemString(pyinfo, "devices");
+    PyObject *pyfirst   = pydevices != NULL ? PySequence_GetItem(pydevices, 0) : NULL;
+    PyErr_Clear();
+    if (pydevices != NULL && (pyfirst == NULL || !PyMapping_Check(pyfirst))) {
+        vjoy_log(VJOY_LOG_WARN, "'devices' must be a non-empty list of dicts, ignoring it.");
+    } else if (pydevices != NULL && PySequence_Size(pydevices) > 1) {
+        pymembers = PySequence_GetSlice(pydevices, 1, PySequence_Size(pydevices));
+    }
+    vjoy_parse_caps(dev, pyfirst != NULL && PyMapping_Check(pyfirst) ? pyfirst : pyinfo);
+    Py_XDECREF(pyfirst);
+    Py_XDECREF(pydevices);
+    // Input loop scheduling
+    dev->devinfo.rate    = VJOY_INPUT_RATE;
+    dev->devinfo.catchup = VJOY_CATCHUP_SKIP;
+    PyErr_Clear(); // Optional keys above may have been missing
+    PyObject *pyrate = PyMapping_GetItemString(pyinfo, "rate");
+    if (pyrate != NULL) {
+        double rate = PyFloat_AsDouble(pyrate);
+        if (rate > 0 || (rate == 0 && PyErr_Occurred() == NULL)) {
+            dev->devinfo.rate = rate;
+        } else {
+            vjoy_log(VJOY_LOG_WARN, "Ignoring invalid rate, using %i Hz.", VJOY_INPUT_RATE);
+        }
+        Py_DECREF(pyrate);
+    }
+    PyErr_Clear();
+    if (dev->devinfo.rate == 0 && dev->devinfo.shmname[0] != '\0') {
+        vjoy_log(VJOY_LOG_WARN, "With rate 0, shared memory input is only read when a descriptor wakes the module.");
+    }
+    PyObject *pycatchup = PyMapping_GetItemString(pyinfo, "catchup");
+    if (pycatchup != NULL) {
+        char* catchup = PyString_AsString(pycatchup);
+        if (catchup != NULL && strcmp(catchup, "burst") == 0) {
+            dev->devinfo.catchup = VJOY_CATCHUP_BURST;
+        } else if (catchup == NULL || strcmp(catchup, "skip") != 0) {
+            vjoy_log(VJOY_LOG_WARN, "Unknown catchup policy, expected 'skip' or 'burst'.");
+        }
+        Py_DECREF(pycatchup);
+    }
+    PyErr_Clear();
+    // Descriptors (or objects with a fileno()) that wake doVJoyRead()
+    PyObject *pyfds = PyMapping_GetItemString(pyinfo, "fds");
+    if (pyfds != NULL) {
+        int count = PySequence_Size(pyfds);
+        for (int i=0; i<count; i++) {
+            PyObject *pyfd = PySequence_GetItem(pyfds, i);
+            int       fd   = pyfd != NULL ? PyObject_AsFileDescriptor(pyfd) : -1;
+            Py_XDECREF(pyfd);
+            if (fd < 0) {
+                vjoy_py_log_error();
+            } else if (dev->devinfo.fdcount >= VJOY_FD_MAX) {
+                vjoy_log(VJOY_LOG_WARN, "Ignoring fd %i, at most %i can be watched.", fd, VJOY_FD_MAX);
+            } else {
+                dev->devinfo.fds[dev->devinfo.fdcount++] = fd;
+            }
+        }
+        Py_DECREF(pyfds);
+    }
+    PyErr_Clear();
+    // Physical devices remapped natively into the group
+    PyObject *pysources = PyMapping_GetItemString(pyinfo, "sources");
+    if (pysources != NULL) {
+        vjoy_source_parse(&dev->devinfo, pysources);
+        Py_DECREF(pysources);
+    }
+    PyErr_Clear();
 
     Py_DECREF(pyinfo);
 
-    pthread_mutex_unlock(&pymutex);
+    vjoy_py_leave(dev);
+    return pymembers;
 }
 
-// TODO: A seperate interpreter for each individual device
-int vjoy_load_module(char* name) {
-    // Create device
-    printf("Creating device:\n");
-    vjoy_dev *dev = malloc(sizeof(vjoy_dev));
-    memset(dev, 0, sizeof(vjoy_dev));
+static int vjoy_reactor_watch(vjoy_reactor *reactor, vjoy_watch *watch,
+                              vjoy_watch_kind kind, int fd, vjoy_dev *dev) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(struct epoll_event));
+    watch->kind = kind;
+    watch->fd   = fd;
+    watch->dev  = dev;
+    ev.events   = EPOLLIN;
+    ev.data.ptr = watch;
+    return epoll_ctl(reactor->epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+static void vjoy_dev_watch_source(vjoy_dev *dev, int i) {
+    if (dev->sources[i] != NULL &&
+        vjoy_reactor_watch(dev->reactor, &dev->sourcewatches[i], VJOY_WATCH_SOURCE,
+                           vjoy_source_fd(dev->sources[i]), dev) < 0) {
+        vjoy_log(VJOY_LOG_ERROR, "Failed to watch source %s: %s", dev->devinfo.sources[i].path, strerror(errno));
+    }
+}
+
+// Open the group's 'sources', watching them right away if it is on a reactor
+static void vjoy_dev_open_sources(vjoy_dev *dev) {
+    for (int i=0; i<dev->devinfo.sourcecount; i++) {
+        const vjoy_source_info *info = &dev->devinfo.sources[i];
+        if (info->device < 0 || info->device >= dev->membercount) {
+            vjoy_log(VJOY_LOG_WARN, "Ignoring source %s, the module has no device %i.", info->path, info->device);
+            continue;
+        }
+        vjoy_dev *target = dev->members[info->device];
+        dev->sources[i]  = vjoy_source_open(info, target);
+        if (dev->sources[i] != NULL && info->ffforward) {
+            if (target->ffsource != NULL) {
+                vjoy_log(VJOY_LOG_WARN, "Device %i already forwards feedback, not to %s as well.", target->id, info->path);
+            } else {
+                target->ffsource = dev->sources[i];
+            }
+        }
+        if (dev->reactor != NULL) {
+            vjoy_dev_watch_source(dev, i);
+        }
+    }
+}
 
-    // Start up Python
-    printf("\tImporting module.\n");
-    pthread_mutex_lock(&pymutex);
+static void vjoy_dev_close_source(vjoy_dev *dev, int i) {
+    if (dev->sources[i] == NULL) {
+        return;
+    }
+    if (dev->reactor != NULL) {
+        epoll_ctl(dev->reactor->epfd, EPOLL_CTL_DEL, vjoy_source_fd(dev->sources[i]), NULL);
+    }
+    for (int m=0; m<dev->membercount; m++) {
+        if (dev->members[m]->ffsource == dev->sources[i]) {
+            dev->members[m]->ffsource = NULL;
+        }
+    }
+    // Events already fetched in this epoll batch see the slot as closed
+    vjoy_source_close(dev->sources[i]);
+    dev->sources[i] = NULL;
+}
+
+/* The device table only changes under this lock.  Reactors never take it;
+ * other threads hold it while they use devices that could be unloaded.
+ */
+void vjoy_devices_lock() {
+    pthread_mutex_lock(&devlock);
+}
+
+void vjoy_devices_unlock() {
+    pthread_mutex_unlock(&devlock);
+}
+
+// Tear down a device that failed to load or was unloaded; it must be unpublished
+static void vjoy_dev_discard(vjoy_dev *dev) {
+    reserved[dev->id] = 0;
+    for (int i=0; i<VJOY_SOURCE_MAX; i++) {
+        vjoy_dev_close_source(dev, i);
+    }
+    vjoy_capture_close(dev);
+    vjoy_shm_destroy(dev);
+    if (dev->backend != NULL) {
+        dev->backend->close(dev);
+    }
+    // Group members share the leader's interpreter, it goes with the leader
+    if (dev->leader != dev) {
+        free(dev);
+        return;
+    }
+    for (int i=1; i<dev->membercount; i++) {
+        vjoy_dev_discard(dev->members[i]);
+    }
+    if (dev->tickfd >= 0) {
+        close(dev->tickfd);
+    }
+    if (dev->resumefd >= 0) {
+        close(dev->resumefd);
+    }
+    PyEval_RestoreThread(dev->pystate);
+    Py_XDECREF(dev->thinkgen);
+    Py_XDECREF(dev->pymodule);
+    Py_EndInterpreter(dev->pystate);
+    PyEval_ReleaseLock();
+    free(dev);
+}
+
+// Import the module into a new interpreter of its own, leaving the GIL released
+static int vjoy_dev_import(vjoy_dev *dev, const char *name) {
+    PyEval_AcquireLock();
+    dev->pystate = vjoy_py_new_interpreter(modulepath);
+    if (dev->pystate == NULL) {
+        vjoy_log(VJOY_LOG_ERROR, "Failed to create interpreter for %s", name);
+        PyEval_ReleaseLock();
+        return -1;
+    }
     dev->pymodule = PyImport_ImportModule(name);
     if (PyErr_Occurred() != NULL) {
-        PyErr_Print();
+        vjoy_py_log_error();
     }
     if (dev->pymodule == NULL) {
-        fprintf(stderr, "Failed to load module %s\n", name);
-        pthread_mutex_unlock(&pymutex);
-        free(dev);
+        vjoy_log(VJOY_LOG_ERROR, "Failed to load module %s", name);
+        Py_EndInterpreter(dev->pystate);
+        PyEval_ReleaseLock();
         return -1;
     }
-    pthread_mutex_unlock(&pymutex);
+    // Lets the module address its device through the native vjoy API
+    PyModule_AddIntConstant(dev->pymodule, "VJoyID", dev->id);
+    // Modules fed through shared memory or transforms may not need a think()
+    dev->hasthink  = PyObject_HasAttrString(dev->pymodule, "doVJoyThink");
+    dev->eventsink = PyObject_HasAttrString(dev->pymodule, "doVJoyEvents") ? VJOY_EVENTS_BATCH :
+                     PyObject_HasAttrString(dev->pymodule, "doVJoyEvent") ? VJOY_EVENTS_SINGLE : VJOY_EVENTS_NONE;
+    PyEval_SaveThread();
+    return 0;
+}
+
+/* Absolute deadlines on CLOCK_MONOTONIC, so think time never adds up to
+ * drift.  The first tick is right away, or a period from now if delayed.
+ */
+static void vjoy_dev_arm_timer(vjoy_dev *dev, int delayed) {
+    struct itimerspec tick;
+    memset(&tick, 0, sizeof(tick));
+    // A rate of 0 leaves the timer disarmed, the module only runs on its fds
+    if (dev->devinfo.rate > 0) {
+        long long period = 1000000000.0 / dev->devinfo.rate;
+        long long first  = vjoy_stats_now() + (delayed ? period : 0);
+        tick.it_value.tv_sec     = first / 1000000000;
+        tick.it_value.tv_nsec    = first % 1000000000;
+        tick.it_interval.tv_sec  = period / 1000000000;
+        tick.it_interval.tv_nsec = period % 1000000000;
+        if (tick.it_interval.tv_sec == 0 && tick.it_interval.tv_nsec == 0) {
+            tick.it_interval.tv_nsec = 1;
+        }
+    }
+    timerfd_settime(dev->tickfd, TFD_TIMER_ABSTIME, &tick, NULL);
+}
+
+// Fire a timer once at deadline (ns on CLOCK_MONOTONIC), or never if 0
+static void vjoy_timer_arm_once(int timerfd, long long deadline) {
+    struct itimerspec wake;
+    memset(&wake, 0, sizeof(wake));
+    wake.it_value.tv_sec  = deadline / 1000000000;
+    wake.it_value.tv_nsec = deadline % 1000000000;
+    timerfd_settime(timerfd, TFD_TIMER_ABSTIME, &wake, NULL);
+}
+
+// Lowest free device id, kept reserved until published or discarded
+static int vjoy_alloc_id() {
+    for (int id=0; id<VJOY_MAX_DEVICES; id++) {
+        if (devices[id] == NULL && !reserved[id]) {
+            reserved[id] = 1;
+            return id;
+        }
+    }
+    vjoy_log(VJOY_LOG_ERROR, "Too many devices, at most %i are supported.", VJOY_MAX_DEVICES);
+    return -1;
+}
+
+// A device for the module to drive: a pooled one with the same capabilities, or a new one
+static int vjoy_dev_output(vjoy_dev *dev) {
+    dev->backend = vjoy_backend_current();
+    if (vjoy_pool_take(dev) == 0) {
+        vjoy_log(VJOY_LOG_INFO, "\tTaking a pre-created device from the pool.");
+        return 0;
+    }
+    if (dev->backend->open(dev) < 0 || dev->backend->create(dev) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/* Create the remaining devices of a multi-device module.  They share the
+ * leader's interpreter, timer and reactor.
+ */
+static int vjoy_load_members(vjoy_dev *leader, PyObject *pymembers) {
+    int result = 0;
+    int count  = PySequence_Size(pymembers);
+    if (count >= VJOY_GROUP_MAX) {
+        vjoy_log(VJOY_LOG_ERROR, "Too many devices, at most %i per module are supported.", VJOY_GROUP_MAX);
+        result = -1;
+    }
+    for (int i=0; result == 0 && i<count; i++) {
+        vjoy_log(VJOY_LOG_INFO, "Creating group device %i:", i + 1);
+        int id = vjoy_alloc_id();
+        if (id < 0) {
+            result = -1;
+            break;
+        }
+        vjoy_dev *dev = malloc(sizeof(vjoy_dev));
+        memset(dev, 0, sizeof(vjoy_dev));
+        dev->id       = id;
+        dev->uifd     = -1;
+        dev->tickfd   = -1;
+        for (int f=0; f<VJOY_FD_MAX; f++) {
+            dev->fdwatches[f].fd = -1;
+        }
+        dev->waitwatch.fd = -1;
+        dev->wakeready    = -1;
+        dev->resumefd     = -1;
+        dev->pymodule = leader->pymodule;
+        dev->pystate  = leader->pystate;
+        dev->hasthink  = leader->hasthink;
+        dev->eventsink = leader->eventsink;
+        dev->leader   = leader;
+        dev->index    = leader->membercount;
+        strncpy(dev->modname, leader->modname, sizeof(dev->modname) - 1);
+        leader->members[leader->membercount++] = dev;
+
+        vjoy_py_enter(dev);
+            PyObject *pyentry = PySequence_GetItem(pymembers, i);
+            if (pyentry != NULL && PyMapping_Check(pyentry)) {
+                vjoy_parse_caps(dev, pyentry);
+            } else {
+                vjoy_log(VJOY_LOG_ERROR, "'devices' entry %i is not a dict.", i + 1);
+                result = -1;
+            }
+            PyErr_Clear();
+            Py_XDECREF(pyentry);
+        vjoy_py_leave(dev);
+        if (result < 0) {
+            break;
+        }
+        dev->devinfo.rate    = leader->devinfo.rate;
+        dev->devinfo.catchup = leader->devinfo.catchup;
+        for (int a=0; a<ABS_CNT; a++) {
+            dev->absstate[a] = dev->devinfo.absinfo[a].value;
+        }
+        vjoy_ff_init(&dev->ff, dev->devinfo.maxeffects);
+        if (vjoy_dev_output(dev) < 0 || vjoy_capture_open(dev) < 0 ||
+            (dev->devinfo.shmname[0] != '\0' && vjoy_shm_create(dev) < 0)) {
+            result = -1;
+        }
+    }
 
-    // Append device to device list
-    printf("\tAppending to device list.\n");
-    devcount++;
-    devices             = realloc(devices, devcount*sizeof(vjoy_dev*));
-    devices[devcount-1] = dev;
+    // Lets the module address every device of the group, VJoyIDs[0] == VJoyID
+    vjoy_py_enter(leader);
+        Py_DECREF(pymembers);
+        PyObject *pyids = PyList_New(leader->membercount);
+        for (int i=0; pyids != NULL && i<leader->membercount; i++) {
+            PyList_SET_ITEM(pyids, i, PyInt_FromLong(leader->members[i]->id));
+        }
+        if (pyids == NULL || PyModule_AddObject(leader->pymodule, "VJoyIDs", pyids) < 0) {
+            vjoy_py_log_error();
+        }
+    vjoy_py_leave(leader);
+    return result;
+}
 
-    // Open a connection to UInput
-    printf("\tInitializing uinput.\n");
-    int paths = sizeof(uinputpaths)/sizeof(char*);
-    for (int i=0; i<paths; i++) {
-        printf("\t\tTrying %s\n", uinputpaths[i]);
-        dev->uifd = open(uinputpaths[i], O_RDWR);
-        if (dev->uifd >= 0) break;
+static int vjoy_load_module_locked(char* name) {
+    // Create device
+    vjoy_log(VJOY_LOG_INFO, "Creating device:");
+    int id = vjoy_alloc_id();
+    if (id < 0) {
+        return -1;
     }
-    if (dev->uifd < 0) {
-        printf("\tFailed to initialize uinput\n");
+    vjoy_dev *dev = malloc(sizeof(vjoy_dev));
+    memset(dev, 0, sizeof(vjoy_dev));
+    dev->id     = id;
+    dev->uifd   = -1;
+    dev->tickfd = -1;
+    for (int i=0; i<VJOY_FD_MAX; i++) {
+        dev->fdwatches[i].fd = -1;
+    }
+    dev->waitwatch.fd = -1;
+    dev->wakeready    = -1;
+    dev->resumefd     = -1;
+    dev->leader      = dev;
+    dev->members[0]  = dev;
+    dev->membercount = 1;
+
+    strncpy(dev->modname, name, sizeof(dev->modname) - 1);
+
+    // Start up Python, each device gets an interpreter of its own
+    vjoy_log(VJOY_LOG_INFO, "\tImporting module.");
+    if (vjoy_dev_import(dev, name) < 0) {
+        reserved[id] = 0;
+        free(dev);
         return -1;
     }
-    printf("\tSucceeded!\n");
 
     // Read device info from the Python module
-    vjoy_parse_info(dev);
-    
-    // Configure uinput device
-    dev->uidev.id.bustype = BUS_VIRTUAL;
+    PyObject *pymembers = vjoy_parse_info(dev);
+    for (int i=0; i<ABS_CNT; i++) {
+        dev->absstate[i] = dev->devinfo.absinfo[i].value;
+    }
 
-    if (dev->devinfo.relaxiscount > 0) {
-        ioctl(dev->uifd, UI_SET_EVBIT, EV_REL);
-        for (int i=0; i<dev->devinfo.relaxiscount; i++) {
-            printf("\tAdding relative axis: %x\n", dev->devinfo.relaxis[i]);
-            ioctl(dev->uifd, UI_SET_RELBIT, dev->devinfo.relaxis[i]);
+    vjoy_log(VJOY_LOG_INFO, "\tMax concurrent effects: %i", dev->devinfo.maxeffects);
+    vjoy_ff_init(&dev->ff, dev->devinfo.maxeffects);
+    if (vjoy_dev_output(dev) < 0 || vjoy_capture_open(dev) < 0 ||
+        (dev->devinfo.shmname[0] != '\0' && vjoy_shm_create(dev) < 0) ||
+        (pymembers != NULL && vjoy_load_members(dev, pymembers) < 0)) {
+        vjoy_dev_discard(dev);
+        return -1;
+    }
+    vjoy_dev_open_sources(dev);
+
+    vjoy_log(VJOY_LOG_INFO, "Device created.");
+
+    vjoy_log(VJOY_LOG_INFO, "\tInput rate: %g Hz (%s on overrun)", dev->devinfo.rate,
+           dev->devinfo.catchup == VJOY_CATCHUP_BURST ? "burst" : "skip");
+    dev->tickfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (dev->tickfd < 0) {
+        vjoy_log(VJOY_LOG_ERROR, "Failed to create tick timer: %s", strerror(errno));
+        vjoy_dev_discard(dev);
+        return -1;
+    }
+    vjoy_dev_arm_timer(dev, 0);
+
+    // Append the group to the device list, before any of its callbacks can run
+    vjoy_log(VJOY_LOG_INFO, "\tAppending to device list.");
+    for (int i=0; i<dev->membercount; i++) {
+        __atomic_store_n(&devices[dev->members[i]->id], dev->members[i], __ATOMIC_RELEASE);
+        reserved[dev->members[i]->id] = 0;
+    }
+
+    // Without reactors (benchmarks) the caller drives vjoy_dev_think() itself
+    if (reactorcount == 0) {
+        return dev->id;
+    }
+
+    // Hand the device to a reactor; it stays there so its callbacks never race
+    dev->reactor = &reactors[dev->id % reactorcount];
+    vjoy_log(VJOY_LOG_INFO, "Attaching device to reactor %i.", (int)(dev->reactor - reactors));
+    // Every group member lives on the leader's reactor, they share an interpreter
+    for (int i=0; i<dev->membercount; i++) {
+        dev->members[i]->reactor = dev->reactor;
+    }
+    for (int i=0; i<dev->membercount && dev->backend->pollable; i++) {
+        vjoy_dev *member = dev->members[i];
+        fcntl(member->uifd, F_SETFL, fcntl(member->uifd, F_GETFL) | O_NONBLOCK);
+        if (vjoy_reactor_watch(dev->reactor, &member->evtwatch, VJOY_WATCH_UINPUT,
+                               member->uifd, member) < 0) {
+            vjoy_log(VJOY_LOG_ERROR, "Failed to attach device to reactor: %s", strerror(errno));
         }
     }
-    if (dev->devinfo.absaxiscount > 0) {
-        ioctl(dev->uifd, UI_SET_EVBIT, EV_ABS);
-        for (int i=0; i<dev->devinfo.absaxiscount; i++) {
-            printf("\tAdding absolute axis: %x\n", dev->devinfo.absaxis[i]);
-            ioctl(dev->uifd, UI_SET_ABSBIT, dev->devinfo.absaxis[i]);
+    if (vjoy_reactor_watch(dev->reactor, &dev->tickwatch, VJOY_WATCH_TICK,
+                           dev->tickfd, dev) < 0) {
+        vjoy_log(VJOY_LOG_ERROR, "Failed to attach device to reactor: %s", strerror(errno));
+    }
+    for (int i=0; i<dev->devinfo.fdcount; i++) {
+        vjoy_log(VJOY_LOG_INFO, "\tWatching fd %i.", dev->devinfo.fds[i]);
+        vjoy_dev_watch_fd(dev, dev->devinfo.fds[i]);
+    }
+    for (int i=0; i<VJOY_SOURCE_MAX; i++) {
+        vjoy_dev_watch_source(dev, i);
+    }
+
+    return dev->id;
+}
+
+// Load a module and create its devices, returning the id of the first
+int vjoy_load_module(char* name) {
+    vjoy_devices_lock();
+    int id = vjoy_load_module_locked(name);
+    vjoy_devices_unlock();
+    return id;
+}
+
+// Wake the device's doVJoyRead() whenever fd becomes readable
+int vjoy_dev_watch_fd(vjoy_dev *dev, int fd) {
+    dev = dev->leader;
+    if (dev->reactor == NULL) {
+        vjoy_log(VJOY_LOG_ERROR, "Device %i has no reactor to watch fds on.", dev->id);
+        return -1;
+    }
+    vjoy_watch *slot = NULL;
+    for (int i=0; i<VJOY_FD_MAX; i++) {
+        if (dev->fdwatches[i].fd == fd) {
+            return 0;
+        }
+        if (slot == NULL && dev->fdwatches[i].fd < 0) {
+            slot = &dev->fdwatches[i];
+        }
+    }
+    if (slot == NULL) {
+        vjoy_log(VJOY_LOG_ERROR, "Device %i already watches %i fds.", dev->id, VJOY_FD_MAX);
+        return -1;
+    }
+    if (vjoy_reactor_watch(dev->reactor, slot, VJOY_WATCH_FD, fd, dev) < 0) {
+        vjoy_log(VJOY_LOG_ERROR, "Failed to watch fd %i: %s", fd, strerror(errno));
+        slot->fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+int vjoy_dev_unwatch_fd(vjoy_dev *dev, int fd) {
+    dev = dev->leader;
+    for (int i=0; i<VJOY_FD_MAX; i++) {
+        if (dev->fdwatches[i].fd == fd && fd >= 0) {
+            epoll_ctl(dev->reactor->epfd, EPOLL_CTL_DEL, fd, NULL);
+            // Events already fetched in this epoll batch see the slot as free
+            dev->fdwatches[i].fd = -1;
+            return 0;
         }
     }
-    if (dev->devinfo.feedbackcount > 0) {
-        ioctl(dev->uifd, UI_SET_EVBIT, EV_FF);
-        for (int i=0; i<dev->devinfo.feedbackcount; i++) {
-            printf("\tAdding feedback effect: %x\n", dev->devinfo.feedback[i]);
-            ioctl(dev->uifd, UI_SET_FFBIT, dev->devinfo.feedback[i]);
+    return -1;
+}
+
+// Stop waiting on the fd a doVJoyThink() generator yielded, if any
+static void vjoy_dev_unwait(vjoy_dev *dev) {
+    if (dev->waitwatch.fd >= 0) {
+        epoll_ctl(dev->reactor->epfd, EPOLL_CTL_DEL, dev->waitwatch.fd, NULL);
+        dev->waitwatch.fd = -1;
+    }
+}
+
+/* Import a changed module afresh for every group running it, and hand the
+ * result to the group's reactor.  Runs on the reload thread; the devices
+ * themselves are only touched by vjoy_dev_swap().  Returns the number of
+ * groups reloaded.
+ */
+int vjoy_reload_module(const char *name) {
+    int reloaded = 0;
+    vjoy_devices_lock();
+    for (int id=0; id<VJOY_MAX_DEVICES; id++) {
+        vjoy_dev *dev = vjoy_get_device(id);
+        if (dev == NULL || dev->leader != dev || strcmp(dev->modname, name) != 0) {
+            continue;
+        }
+        vjoy_log(VJOY_LOG_INFO, "Reloading module %s for device %i.", name, dev->id);
+        // Parse into a scratch device, so the live one is never written here
+        vjoy_dev *scratch = malloc(sizeof(vjoy_dev));
+        memset(scratch, 0, sizeof(vjoy_dev));
+        scratch->id = dev->id;
+        if (vjoy_dev_import(scratch, name) < 0) {
+            vjoy_log(VJOY_LOG_ERROR, "Keeping the running version of %s.", name);
+            free(scratch);
+            continue;
+        }
+        vjoy_reload *next  = malloc(sizeof(vjoy_reload));
+        PyObject    *pymembers = vjoy_parse_info(scratch);
+        next->pystate      = scratch->pystate;
+        next->pymodule     = scratch->pymodule;
+        next->hasthink     = scratch->hasthink;
+        next->eventsink    = scratch->eventsink;
+        next->info[0]      = scratch->devinfo;
+        next->transform[0] = scratch->transform;
+        next->membercount  = 1;
+        vjoy_py_enter(scratch);
+            int count = pymembers != NULL ? PySequence_Size(pymembers) : 0;
+            for (int i=0; i<count && next->membercount<VJOY_GROUP_MAX; i++) {
+                PyObject *pyentry = PySequence_GetItem(pymembers, i);
+                // Default names, e.g. of shared memory, follow the member's id
+                if (next->membercount < dev->membercount) {
+                    scratch->id = dev->members[next->membercount]->id;
+                }
+                if (pyentry != NULL && PyMapping_Check(pyentry)) {
+                    vjoy_parse_caps(scratch, pyentry);
+                }
+                PyErr_Clear();
+                Py_XDECREF(pyentry);
+                next->info[next->membercount]           = scratch->devinfo;
+                next->info[next->membercount].rate      = next->info[0].rate;
+                next->info[next->membercount].catchup   = next->info[0].catchup;
+                next->transform[next->membercount++]    = scratch->transform;
+            }
+            Py_XDECREF(pymembers);
+            if (dev->membercount > 1) {
+                PyObject *pyids = PyList_New(dev->membercount);
+                for (int i=0; pyids != NULL && i<dev->membercount; i++) {
+                    PyList_SET_ITEM(pyids, i, PyInt_FromLong(dev->members[i]->id));
+                }
+                if (pyids == NULL || PyModule_AddObject(next->pymodule, "VJoyIDs", pyids) < 0) {
+                    vjoy_py_log_error();
+                }
+            }
+        vjoy_py_leave(scratch);
+        free(scratch);
+        if (next->membercount != dev->membercount) {
+            vjoy_log(VJOY_LOG_ERROR, "Module %s now declares %i devices instead of %i, restart vjoy to apply it.",
+                     name, next->membercount, dev->membercount);
+            vjoy_reload_discard(next);
+            continue;
+        }
+
+        // A reload the reactor has not picked up yet is superseded
+        vjoy_reload *stale = __atomic_exchange_n(&dev->reload, next, __ATOMIC_ACQ_REL);
+        if (stale != NULL) {
+            vjoy_reload_discard(stale);
         }
+        // A module running on its fds alone, or asleep without ticks, has no tick to swap on; fire one
+        if (dev->devinfo.rate == 0 || __atomic_load_n(&dev->asleep, __ATOMIC_RELAXED)) {
+            struct itimerspec once;
+            memset(&once, 0, sizeof(once));
+            once.it_value.tv_nsec = 1;
+            timerfd_settime(dev->tickfd, 0, &once, NULL);
+        }
+        reloaded++;
+    }
+    vjoy_devices_unlock();
+    return reloaded;
+}
+
+// Everything in vjoy_info before the scheduling keys is a capability
+int vjoy_info_caps_equal(const vjoy_info *a, const vjoy_info *b) {
+    return memcmp(a, b, offsetof(vjoy_info, rate)) == 0;
+}
+
+/* Import a module only to read the capabilities of its devices, e.g. to
+ * pre-create matching ones.  Returns how many were stored in info.
+ */
+int vjoy_module_info(const char *name, vjoy_info *info, int max) {
+    vjoy_dev *scratch = malloc(sizeof(vjoy_dev));
+    memset(scratch, 0, sizeof(vjoy_dev));
+    if (vjoy_dev_import(scratch, name) < 0) {
+        free(scratch);
+        return -1;
     }
-    if (dev->devinfo.buttoncount > 0) {
-        ioctl(dev->uifd, UI_SET_EVBIT, EV_KEY);
-        for (int i=0; i<dev->devinfo.buttoncount; i++) {
-            printf("\tAdding key/button: %x\n", dev->devinfo.buttons[i]);
-            ioctl(dev->uifd, UI_SET_KEYBIT, dev->devinfo.buttons[i]);
+    int       count     = 0;
+    PyObject *pymembers = vjoy_parse_info(scratch);
+    if (max > 0) {
+        info[count++] = scratch->devinfo;
+    }
+    PyEval_RestoreThread(scratch->pystate);
+        int size = pymembers != NULL ? PySequence_Size(pymembers) : 0;
+        for (int i=0; i<size && count<max; i++) {
+            PyObject *pyentry = PySequence_GetItem(pymembers, i);
+            if (pyentry != NULL && PyMapping_Check(pyentry)) {
+                vjoy_parse_caps(scratch, pyentry);
+                info[count++] = scratch->devinfo;
+            }
+            PyErr_Clear();
+            Py_XDECREF(pyentry);
         }
+        Py_XDECREF(pymembers);
+        Py_DECREF(scratch->pymodule);
+    Py_EndInterpreter(scratch->pystate);
+    PyEval_ReleaseLock();
+    free(scratch);
+    return count;
+}
+
+// Bring a device back to rest: keys released, axes at their initial value
+static void vjoy_dev_rest(vjoy_dev *dev) {
+    gettimeofday(&dev->frametime, NULL);
+    for (int code=0; code<KEY_CNT; code++) {
+        if (dev->keystate[code / VJOY_LONG_BITS] & (1UL << (code % VJOY_LONG_BITS))) {
+            vjoy_dev_emit(dev, EV_KEY, code, 0);
+        }
+    }
+    for (int code=0; code<ABS_CNT; code++) {
+        vjoy_dev_emit(dev, EV_ABS, code, dev->devinfo.absinfo[code].value);
     }
+    vjoy_dev_emit(dev, EV_SYN, SYN_REPORT, 0);
+    vjoy_dev_flush(dev);
+}
 
-    for (int i=0; i<ABS_MAX; i++) {
-        dev->uidev.absmin[i] = SHRT_MIN;
-        dev->uidev.absmax[i] = SHRT_MAX;
+// Wait until the reactor is done with the epoll batch it is in, if any
+static void vjoy_reactor_sync(vjoy_reactor *reactor) {
+    unsigned long   batch = __atomic_load_n(&reactor->batches, __ATOMIC_ACQUIRE);
+    uint64_t        one   = 1;
+    struct timespec pause = {0, 1000000};
+    if (write(reactor->wakefd, &one, sizeof(one)) != sizeof(one)) {
+        vjoy_log(VJOY_LOG_WARN, "Failed to wake reactor: %s", strerror(errno));
     }
-    printf("\tMax concurrent effects: %i\n", dev->devinfo.maxeffects);
-    dev->uidev.ff_effects_max = dev->devinfo.maxeffects;
+    while (__atomic_load_n(&reactor->batches, __ATOMIC_ACQUIRE) == batch) {
+        nanosleep(&pause, NULL);
+    }
+}
 
-    write(dev->uifd, &dev->uidev, sizeof(struct uinput_user_dev));
-    
-    int err = ioctl(dev->uifd, UI_DEV_CREATE);
-    if (err != 0) {
-        fprintf(stderr, "Device creation failed.\n");
-        exit(1);
+/* Pooled devices have no module, but are visible like any other and the
+ * kernel queues requests to them all the same.  The first reactor drains
+ * them and turns force feedback uploads down, instead of leaving the
+ * application blocked until uinput times out.
+ */
+int vjoy_reactor_watch_idle(vjoy_watch *watch, int fd) {
+    watch->fd = -1;
+    if (reactorcount == 0 || !vjoy_backend_current()->pollable) {
+        return 0;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    if (vjoy_reactor_watch(&reactors[0], watch, VJOY_WATCH_IDLE, fd, NULL) < 0) {
+        vjoy_log(VJOY_LOG_ERROR, "Failed to watch pooled device: %s", strerror(errno));
+        watch->fd = -1;
+        return -1;
     }
+    return 0;
+}
 
-    printf("Device created.\n");
+// Hand a pooled device over to a module, whose reactor reads it from now on
+void vjoy_reactor_unwatch_idle(vjoy_watch *watch) {
+    if (watch->fd < 0) {
+        return;
+    }
+    epoll_ctl(reactors[0].epfd, EPOLL_CTL_DEL, watch->fd, NULL);
+    watch->fd = -1;
+    vjoy_reactor_sync(&reactors[0]);
+}
+
+static void vjoy_idle_ready(vjoy_watch *watch) {
+    struct input_event events[VJOY_READ_BATCH];
+    ssize_t            s;
+    while (watch->fd >= 0 && (s = read(watch->fd, events, sizeof(events))) > 0) {
+        for (int i=0; i<s / (ssize_t)sizeof(struct input_event); i++) {
+            if (events[i].type != EV_UINPUT) {
+                continue;
+            }
+            if (events[i].code == UI_FF_UPLOAD) {
+                struct uinput_ff_upload ureq;
+                memset(&ureq, 0, sizeof(struct uinput_ff_upload));
+                ureq.request_id = events[i].value;
+                ioctl(watch->fd, UI_BEGIN_FF_UPLOAD, &ureq);
+                ureq.retval = -ENODEV;
+                ioctl(watch->fd, UI_END_FF_UPLOAD, &ureq);
+            } else if (events[i].code == UI_FF_ERASE) {
+                struct uinput_ff_erase ereq;
+                memset(&ereq, 0, sizeof(struct uinput_ff_erase));
+                ereq.request_id = events[i].value;
+                ioctl(watch->fd, UI_BEGIN_FF_ERASE, &ereq);
+                ioctl(watch->fd, UI_END_FF_ERASE, &ereq);
+            }
+        }
+        if (s < (ssize_t)sizeof(events)) {
+            break;
+        }
+    }
+}
 
-    printf("Starting device control threads.\n");
-    pthread_create(&dev->inptthread, NULL, vjoy_dev_input_loop, dev);
-    pthread_create(&dev->evtthread,  NULL, vjoy_dev_event_loop, dev);
+/* Take a group off its reactor.  Its watches are removed first, then the
+ * reactor is woken and waited on until it has finished the epoll batch it
+ * is in, the last one that could still refer to the group.
+ */
+static void vjoy_dev_detach(vjoy_dev *dev) {
+    vjoy_reactor *reactor = dev->reactor;
+    if (reactor == NULL) {
+        return;
+    }
+    for (int i=0; i<dev->membercount && dev->backend->pollable; i++) {
+        epoll_ctl(reactor->epfd, EPOLL_CTL_DEL, dev->members[i]->uifd, NULL);
+    }
+    epoll_ctl(reactor->epfd, EPOLL_CTL_DEL, dev->tickfd, NULL);
+    if (dev->resumefd >= 0) {
+        epoll_ctl(reactor->epfd, EPOLL_CTL_DEL, dev->resumefd, NULL);
+    }
+    for (int i=0; i<VJOY_FD_MAX; i++) {
+        vjoy_dev_unwatch_fd(dev, dev->fdwatches[i].fd);
+    }
+    vjoy_dev_unwait(dev);
+    for (int i=0; i<VJOY_SOURCE_MAX; i++) {
+        if (dev->sources[i] != NULL) {
+            epoll_ctl(reactor->epfd, EPOLL_CTL_DEL, vjoy_source_fd(dev->sources[i]), NULL);
+        }
+    }
+    vjoy_reactor_sync(reactor);
+    for (int i=0; i<dev->membercount; i++) {
+        dev->members[i]->reactor = NULL;
+    }
+}
 
+/* Remove a module's devices at runtime; any id of a group removes all of
+ * it.  Devices the pool is short of go back to it, at rest, instead of
+ * being destroyed.
+ */
+int vjoy_unload_device(int id) {
+    vjoy_devices_lock();
+    vjoy_dev *dev = vjoy_get_device(id);
+    if (dev == NULL) {
+        vjoy_devices_unlock();
+        return -1;
+    }
+    dev = dev->leader;
+    vjoy_log(VJOY_LOG_INFO, "Unloading module %s (device %i).", dev->modname, dev->id);
+    for (int i=0; i<dev->membercount; i++) {
+        __atomic_store_n(&devices[dev->members[i]->id], NULL, __ATOMIC_RELEASE);
+    }
+    vjoy_dev_detach(dev);
+    vjoy_reload *pending = __atomic_exchange_n(&dev->reload, NULL, __ATOMIC_ACQ_REL);
+    if (pending != NULL) {
+        vjoy_reload_discard(pending);
+    }
+    for (int i=0; i<dev->membercount; i++) {
+        vjoy_dev *member = dev->members[i];
+        if (vjoy_pool_wants(&member->devinfo)) {
+            vjoy_dev_rest(member);
+            vjoy_pool_put(member);
+        }
+    }
+    vjoy_dev_discard(dev);
+    vjoy_devices_unlock();
     return 0;
 }
 
-void *vjoy_dev_event_loop(void *arg) {
-    vjoy_dev               *dev = arg;
-    int                     s;
-    struct input_event      evt;
-    struct uinput_ff_upload ureq;
-    struct uinput_ff_erase  ereq;
-    PyObject               *res;
+// Drop a module that never ran, or the one a reload replaced
+void vjoy_reload_discard(vjoy_reload *reload) {
+    PyEval_RestoreThread(reload->pystate);
+    Py_XDECREF(reload->pymodule);
+    Py_EndInterpreter(reload->pystate);
+    PyEval_ReleaseLock();
+    free(reload);
+}
+
+// Recreate a device whose capabilities changed, keeping its id
+static void vjoy_dev_rebuild(vjoy_dev *dev, const vjoy_info *info) {
+    vjoy_log(VJOY_LOG_INFO, "Capabilities of device %i changed, recreating it.", dev->id);
+    if (dev->backend->pollable && dev->reactor != NULL) {
+        epoll_ctl(dev->reactor->epfd, EPOLL_CTL_DEL, dev->uifd, NULL);
+    }
+    dev->backend->close(dev);
+    dev->devinfo = *info;
+    memset(&dev->uidev, 0, sizeof(struct uinput_user_dev));
+    strncpy(dev->uidev.name, info->name, UINPUT_MAX_NAME_SIZE);
+    // The new device starts out at rest, and so does the state mirroring it
+    for (int i=0; i<ABS_CNT; i++) {
+        dev->absstate[i] = info->absinfo[i].value;
+    }
+    memset(dev->keystate, 0, sizeof(dev->keystate));
+    memset(dev->relpending, 0, sizeof(dev->relpending));
+    dev->relmask    = 0;
+    dev->framelen   = 0;
+    dev->framedirty = 0;
+    vjoy_ff_init(&dev->ff, info->maxeffects);
+    if (dev->backend->open(dev) < 0 || dev->backend->create(dev) < 0) {
+        vjoy_log(VJOY_LOG_ERROR, "Failed to recreate device %i.", dev->id);
+        return;
+    }
+    if (dev->backend->pollable && dev->reactor != NULL) {
+        fcntl(dev->uifd, F_SETFL, fcntl(dev->uifd, F_GETFL) | O_NONBLOCK);
+        if (vjoy_reactor_watch(dev->reactor, &dev->evtwatch, VJOY_WATCH_UINPUT, dev->uifd, dev) < 0) {
+            vjoy_log(VJOY_LOG_ERROR, "Failed to attach device to reactor: %s", strerror(errno));
+        }
+    }
+}
+
+/* Switch a group over to a reloaded module between two ticks.  Devices
+ * whose capabilities are unchanged keep their uinput descriptor and every
+ * axis and key state; transforms pick up the latest raw samples.
+ */
+static void vjoy_dev_swap(vjoy_dev *dev) {
+    vjoy_reload *next = __atomic_exchange_n(&dev->reload, NULL, __ATOMIC_ACQ_REL);
+    if (next == NULL) {
+        return;
+    }
+    double         rate      = dev->devinfo.rate;
+    PyThreadState *oldstate  = dev->pystate;
+    PyObject      *oldmodule = dev->pymodule;
+    // Sources are reopened if they or a device they feed changed, which also
+    // resyncs the new tables with the physical state
+    int            sources   = dev->devinfo.sourcecount != next->info[0].sourcecount ||
+                               memcmp(dev->devinfo.sources, next->info[0].sources, sizeof(dev->devinfo.sources)) != 0;
+    // The old module's descriptors and generator go away with its interpreter
+    for (int i=0; i<VJOY_FD_MAX; i++) {
+        vjoy_dev_unwatch_fd(dev, dev->fdwatches[i].fd);
+    }
+    vjoy_dev_unwait(dev);
+    int asleep = dev->asleep;
+    if (dev->thinkgen != NULL) {
+        vjoy_py_enter(dev);
+            Py_CLEAR(dev->thinkgen);
+        vjoy_py_leave(dev);
+    }
+    if (dev->resumefd >= 0) {
+        vjoy_timer_arm_once(dev->resumefd, 0);
+    }
+    __atomic_store_n(&dev->asleep, 0, __ATOMIC_RELAXED);
+    dev->wakeready = -1;
+    for (int i=0; i<dev->membercount; i++) {
+        vjoy_dev *member = dev->members[i];
+        int       raw[VJOY_RAW_MAX];
+        memcpy(raw, member->transform.raw, sizeof(raw));
+        member->transform = next->transform[i];
+        memcpy(member->transform.raw, raw, sizeof(raw));
+        member->transform.dirty = 1;
+        if (!vjoy_info_caps_equal(&member->devinfo, &next->info[i])) {
+            vjoy_dev_rebuild(member, &next->info[i]);
+            sources = 1;
+        }
+        // Producers keep their mapping as long as the region keeps its name
+        if (member->shm != NULL && strcmp(member->devinfo.shmname, next->info[i].shmname) != 0) {
+            vjoy_shm_destroy(member);
+        }
+        member->devinfo  = next->info[i];
+        member->pymodule = next->pymodule;
+        member->pystate  = next->pystate;
+        member->hasthink  = next->hasthink;
+        member->eventsink = next->eventsink;
+        if (member->shm == NULL && member->devinfo.shmname[0] != '\0') {
+            vjoy_shm_create(member);
+        }
+    }
+    if (dev->devinfo.rate != rate || rate == 0 || asleep) {
+        vjoy_dev_arm_timer(dev, 0);
+    }
+    for (int i=0; i<dev->devinfo.fdcount; i++) {
+        vjoy_dev_watch_fd(dev, dev->devinfo.fds[i]);
+    }
+    if (sources) {
+        for (int i=0; i<VJOY_SOURCE_MAX; i++) {
+            vjoy_dev_close_source(dev, i);
+        }
+        vjoy_dev_open_sources(dev);
+    }
+    // The old interpreter is torn down like a module that never ran
+    next->pystate  = oldstate;
+    next->pymodule = oldmodule;
+    vjoy_reload_discard(next);
+    vjoy_log(VJOY_LOG_INFO, "Device %i now runs the reloaded %s.", dev->id, dev->modname);
+}
+
+void *vjoy_reactor_loop(void *arg) {
+    vjoy_reactor       *reactor = arg;
+    struct epoll_event  ready[VJOY_EPOLL_BATCH];
     while (1) {
-	printf("Waiting for events.\n");
-        s = read(dev->uifd, &evt, sizeof(struct input_event));
-        if (s != sizeof(struct input_event)) {
-            fprintf(stderr, "Error reading event structure.\n");
+        int n = epoll_wait(reactor->epfd, ready, VJOY_EPOLL_BATCH, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            static vjoy_log_limit waiterr;
+            vjoy_log_limited(&waiterr, VJOY_LOG_ERROR, "Error waiting on reactor: %s", strerror(errno));
             continue;
         }
-        printf("Event recieved.\n\tType: %x\n\tCode: %x\n\tValue: %x\n", evt.type, evt.code, evt.value);
-        switch (evt.type) {
-            case EV_UINPUT:
-                switch (evt.code) {
-                    case UI_FF_UPLOAD:
-                        memset(&ureq, 0, sizeof(struct uinput_ff_upload));
-                        ureq.request_id = evt.value;
-                        ioctl(dev->uifd, UI_BEGIN_FF_UPLOAD, &ureq);
-                        pthread_mutex_lock(&pymutex);
-                            PyObject *pyeffect = vjoy_convert_ff_effect(&ureq.effect);
-                            PyObject *res = PyObject_CallMethod(dev->pymodule, "doVJoyUploadFeedback", "O", pyeffect);
-                            Py_XDECREF(res);
-                            if (PyErr_Occurred() != NULL) {
-                                PyErr_Print();
-                            }
-                        pthread_mutex_unlock(&pymutex);
-                        ioctl(dev->uifd, UI_END_FF_UPLOAD, &ureq);
-                        break;
-                    case UI_FF_ERASE:
-                        memset(&ereq, 0, sizeof(struct uinput_ff_erase));
-                        ereq.request_id = evt.value;
-                        ioctl(dev->uifd, UI_BEGIN_FF_ERASE, &ereq);
-                        pthread_mutex_lock(&pymutex);
-                            res = PyObject_CallMethod(dev->pymodule, "doVJoyEraseFeedback", "i", ereq.effect_id);
-                            Py_XDECREF(res);
-                            if (PyErr_Occurred() != NULL) {
-                                PyErr_Print();
-                            }
-                        pthread_mutex_unlock(&pymutex);
-                        ioctl(dev->uifd, UI_END_FF_ERASE, &ereq);
-                        break;
-                    default:
-                        break;
+        for (int i=0; i<n; i++) {
+            vjoy_watch *watch = ready[i].data.ptr;
+            switch (watch->kind) {
+                case VJOY_WATCH_UINPUT:
+                    vjoy_dev_event_ready(watch->dev);
+                    break;
+                case VJOY_WATCH_TICK:
+                    vjoy_dev_input_ready(watch->dev);
+                    break;
+                case VJOY_WATCH_FD:
+                    vjoy_dev_read_ready(watch->dev, watch, ready[i].events);
+                    break;
+                case VJOY_WATCH_SOURCE:
+                    vjoy_dev_source_ready(watch->dev, watch);
+                    break;
+                case VJOY_WATCH_WAIT:
+                    vjoy_dev_wait_ready(watch->dev);
+                    break;
+                case VJOY_WATCH_RESUME:
+                    vjoy_dev_resume_ready(watch->dev);
+                    break;
+                case VJOY_WATCH_IDLE:
+                    vjoy_idle_ready(watch);
+                    break;
+                case VJOY_WATCH_WAKE: {
+                    uint64_t count;
+                    if (read(reactor->wakefd, &count, sizeof(count)) < 0) {
+                        static vjoy_log_limit wakeerr;
+                        vjoy_log_limited(&wakeerr, VJOY_LOG_ERROR, "Error reading reactor wakeup.");
+                    }
+                    break;
                 }
-                break;
-            default:
-                pthread_mutex_lock(&pymutex);
-                    res = PyObject_CallMethod(dev->pymodule, "doVJoyEvent", "iii", evt.type, evt.code, evt.value);
+            }
+        }
+        // Nothing from this batch is referenced past this point
+        __atomic_add_fetch(&reactor->batches, 1, __ATOMIC_RELEASE);
+    }
+}
+
+static int vjoy_group_ff_pending(vjoy_dev *leader) {
+    for (int i=0; i<leader->membercount; i++) {
+        vjoy_ff_state *ff = &leader->members[i]->ff;
+        if (__atomic_load_n(&ff->head, __ATOMIC_ACQUIRE) != ff->tail) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Hand the module the feedback uploads and erasures answered since the
+ * last call, oldest first.  Called with the group's interpreter entered.
+ */
+static void vjoy_group_ff_deliver(vjoy_dev *leader) {
+    vjoy_ff_notice  notice;
+    PyObject       *res;
+    for (int i=0; i<leader->membercount; i++) {
+        vjoy_dev *dev = leader->members[i];
+        while (vjoy_ff_next_notice(&dev->ff, &notice)) {
+            if (notice.erase) {
+                res = leader->membercount > 1 ?
+                      PyObject_CallMethod(dev->pymodule, "doVJoyEraseFeedback", "ii", notice.effect.id, dev->index) :
+                      PyObject_CallMethod(dev->pymodule, "doVJoyEraseFeedback", "i", notice.effect.id);
+                Py_XDECREF(res);
+            } else {
+                PyObject *pyeffect = vjoy_convert_ff_effect(&notice.effect);
+                if (pyeffect != NULL) {
+                    res = leader->membercount > 1 ?
+                          PyObject_CallMethod(dev->pymodule, "doVJoyUploadFeedback", "Oi", pyeffect, dev->index) :
+                          PyObject_CallMethod(dev->pymodule, "doVJoyUploadFeedback", "O", pyeffect);
                     Py_XDECREF(res);
-                    if (PyErr_Occurred() != NULL) {
-                        PyErr_Print();
-                    }
-                pthread_mutex_unlock(&pymutex);
-                break;
+                    Py_DECREF(pyeffect);
+                }
+            }
+            if (PyErr_Occurred() != NULL) {
+                vjoy_py_log_error();
+            }
         }
     }
 }
 
-void *vjoy_dev_input_loop(void *arg) {
-    vjoy_dev           *dev = arg;
-    PyObject           *pyevents;
-    struct input_event  evt;
-    while (1) {
-        pthread_mutex_lock(&pymutex);
-            pyevents = PyObject_CallMethod(dev->pymodule, "doVJoyThink", NULL);
+// Axis position rescaled from its declared range to the -32767..32767 FF expects
+static int vjoy_dev_ff_position(vjoy_dev *dev, int axis) {
+    if (axis >= dev->devinfo.absaxiscount) {
+        return 0;
+    }
+    struct input_absinfo *abs = &dev->devinfo.absinfo[dev->devinfo.absaxis[axis]];
+    double half = (abs->maximum - (double)abs->minimum) / 2.0;
+    double mid  = (abs->maximum + (double)abs->minimum) / 2.0;
+    return (dev->absstate[dev->devinfo.absaxis[axis]] - mid) * SHRT_MAX / half;
+}
+
+// Mix every member's playing effects as of now, for vjoy.get_force()
+static void vjoy_group_ff_evaluate(vjoy_dev *dev, long long now) {
+    for (int i=0; i<dev->membercount; i++) {
+        vjoy_dev *member = dev->members[i];
+        if (member->devinfo.feedbackcount > 0) {
+            vjoy_ff_evaluate(&member->ff, now, vjoy_dev_ff_position(member, 0), vjoy_dev_ff_position(member, 1));
+        }
+    }
+}
+
+// Serve one force feedback upload or erasure request from the kernel
+static void vjoy_dev_ff_request(vjoy_dev *dev, const struct input_event *evt) {
+    struct uinput_ff_upload ureq;
+    struct uinput_ff_erase  ereq;
+    unsigned long long      started;
+    switch (evt->code) {
+        case UI_FF_UPLOAD:
+            memset(&ureq, 0, sizeof(struct uinput_ff_upload));
+            ureq.request_id = evt->value;
+            started = vjoy_stats_now();
+            ioctl(dev->uifd, UI_BEGIN_FF_UPLOAD, &ureq);
+            // Answered from the effect table alone, the module hears of it later
+            if (vjoy_ff_upload(&dev->ff, &ureq.effect) < 0) {
+                static vjoy_log_limit uploaderr;
+                vjoy_log_limited(&uploaderr, VJOY_LOG_WARN, "Rejecting upload of effect %i, out of range.", ureq.effect.id);
+                ureq.retval = -EINVAL;
+            }
+            ioctl(dev->uifd, UI_END_FF_UPLOAD, &ureq);
+            vjoy_hist_record(&dev->stats.ffupload, vjoy_stats_now() - started);
+            vjoy_stat_add(&dev->stats.ffuploads, 1);
+            vjoy_stat_add(&dev->stats.syscalls, 2);
+            if (ureq.retval == 0 && dev->ffsource != NULL) {
+                vjoy_source_ff_upload(dev->ffsource, &ureq.effect);
+            }
+            if (ureq.retval == 0 && vjoy_ff_notify(&dev->ff, 0, &ureq.effect) < 0) {
+                static vjoy_log_limit uploadfull;
+                vjoy_log_limited(&uploadfull, VJOY_LOG_WARN, "Module is not keeping up with feedback uploads, dropping notices.");
+            }
+            break;
+        case UI_FF_ERASE:
+            memset(&ereq, 0, sizeof(struct uinput_ff_erase));
+            ereq.request_id = evt->value;
+            ioctl(dev->uifd, UI_BEGIN_FF_ERASE, &ereq);
+            vjoy_ff_erase(&dev->ff, ereq.effect_id);
+            ioctl(dev->uifd, UI_END_FF_ERASE, &ereq);
+            vjoy_stat_add(&dev->stats.fferasures, 1);
+            vjoy_stat_add(&dev->stats.syscalls, 2);
+            if (dev->ffsource != NULL) {
+                vjoy_source_ff_erase(dev->ffsource, ereq.effect_id);
+            }
+            memset(&ureq.effect, 0, sizeof(struct ff_effect));
+            ureq.effect.id = ereq.effect_id;
+            if (vjoy_ff_notify(&dev->ff, 1, &ureq.effect) < 0) {
+                static vjoy_log_limit erasefull;
+                vjoy_log_limited(&erasefull, VJOY_LOG_WARN, "Module is not keeping up with feedback erasures, dropping notices.");
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/* Pass events read from the kernel to the module, entering Python once.
+ * doVJoyEvents() gets each SYN_REPORT-terminated group as one buffer of
+ * vjoy.EVENT_FORMAT records; older modules get doVJoyEvent() per event.
+ * Unless final, a trailing unterminated group is left for the next read;
+ * returns how many events were passed on.
+ */
+static int vjoy_dev_deliver_events(vjoy_dev *dev, const vjoy_packed_event *events, int count, int final) {
+    PyObject *res;
+    int       grouped = dev->leader->membercount > 1;
+    int       start   = 0;
+    vjoy_py_enter(dev);
+        for (int i=0; i<count; i++) {
+            if (dev->eventsink == VJOY_EVENTS_SINGLE) {
+                res = grouped ?
+                      PyObject_CallMethod(dev->pymodule, "doVJoyEvent", "iiii", events[i].type, events[i].code, events[i].value, dev->index) :
+                      PyObject_CallMethod(dev->pymodule, "doVJoyEvent", "iii", events[i].type, events[i].code, events[i].value);
+                start = i + 1;
+            } else if ((events[i].type == EV_SYN && events[i].code == SYN_REPORT) || (final && i == count - 1)) {
+                PyObject *pybatch = PyString_FromStringAndSize((const char*)&events[start],
+                                                               (i + 1 - start) * sizeof(vjoy_packed_event));
+                start = i + 1;
+                if (pybatch == NULL) {
+                    vjoy_py_log_error();
+                    continue;
+                }
+                res = grouped ?
+                      PyObject_CallMethod(dev->pymodule, "doVJoyEvents", "Oi", pybatch, dev->index) :
+                      PyObject_CallMethod(dev->pymodule, "doVJoyEvents", "O", pybatch);
+                Py_DECREF(pybatch);
+            } else {
+                continue;
+            }
+            Py_XDECREF(res);
             if (PyErr_Occurred() != NULL) {
-                PyErr_Print();
+                vjoy_py_log_error();
             }
-            if (pyevents != NULL) {
-                int eventcount = PySequence_Size(pyevents);
-                if (eventcount > 0) {
-                    memset(&evt, 0, sizeof(struct input_event));
-                    gettimeofday(&evt.time, NULL);
-                    // TODO: This all needs more error checking
-                    for (int i=0; i<eventcount; i++) {
-                        PyObject *pyevent = PySequence_GetItem(pyevents, i);
-                        if (pyevent != NULL) {
-                            if (PySequence_Size(pyevent) != 3) {
-                                fprintf(stderr, "Event lists must have exactly three items in the form (type, code, value)\n");
-                                continue;
-                            }
-                            PyObject *pytype = PySequence_GetItem(pyevent, 0);
-                            if (pytype != NULL) {
-                                evt.type = PyInt_AsLong(pytype);
-                                Py_DECREF(pytype);
-                            }
-                            PyObject *pycode = PySequence_GetItem(pyevent, 1);
-                            if (pycode != NULL) {
-                                evt.code = PyInt_AsLong(pycode);
-                                Py_DECREF(pycode);
-                            }
-                            PyObject *pyvalue = PySequence_GetItem(pyevent, 2);
-                            if (pyvalue != NULL) {
-                                evt.value = PyInt_AsLong(pyvalue);
-                                Py_DECREF(pyvalue);
-                            }
-                            Py_DECREF(pyevent);
-                        }
-                        write(dev->uifd, &evt, sizeof(struct input_event));
-                    }
-                    evt.type  = EV_SYN;
-                    evt.code  = SYN_REPORT;
-                    evt.value = 0;
-                    write(dev->uifd, &evt, sizeof(struct input_event));
+        }
+    vjoy_py_leave(dev);
+    return start;
+}
+
+/* Drain everything the kernel has queued on the device without blocking,
+ * up to VJOY_READ_BATCH events per read().  In a multi-device module the
+ * callbacks get the device's group index as an extra last argument.
+ */
+void vjoy_dev_event_ready(vjoy_dev *dev) {
+    struct input_event evts[VJOY_READ_BATCH];
+    vjoy_packed_event  batch[VJOY_READ_BATCH * 2]; // Room for a group carried over
+    int                batchlen = 0;
+    ssize_t            s;
+    while (1) {
+        s = read(dev->uifd, evts, sizeof(evts));
+        vjoy_stat_add(&dev->stats.syscalls, 1);
+        if (s < 0 && errno == EINTR) {
+            continue;
+        }
+        if (s < 0 && errno == EAGAIN) {
+            break;
+        }
+        if (s <= 0 || s % sizeof(struct input_event) != 0) {
+            static vjoy_log_limit readerr;
+            vjoy_log_limited(&readerr, VJOY_LOG_ERROR, "Error reading event structure.");
+            break;
+        }
+        int count = s / sizeof(struct input_event);
+        vjoy_stat_add(&dev->stats.eventsin, count);
+        for (int i=0; i<count; i++) {
+            struct input_event *evt = &evts[i];
+            vjoy_log(VJOY_LOG_DEBUG, "Event recieved.\n\tType: %x\n\tCode: %x\n\tValue: %x", evt->type, evt->code, evt->value);
+            if (evt->type == EV_UINPUT) {
+                vjoy_dev_ff_request(dev, evt);
+                continue;
+            }
+            if (evt->type == EV_FF) {
+                vjoy_ff_event(&dev->ff, evt->code, evt->value, vjoy_ff_now());
+                if (dev->ffsource != NULL) {
+                    vjoy_source_ff_event(dev->ffsource, evt->code, evt->value);
                 }
-                Py_DECREF(pyevents);
             }
-        pthread_mutex_unlock(&pymutex);
-        usleep(VJOY_INPUT_DELAY);
-    }
-}
-
-PyObject *vjoy_convert_ff_envelope(struct ff_envelope *envelope) {
-    PyObject *pyenvelope = PyDict_New();
-    PyDict_SetItemString(pyenvelope, "attack_length", PyInt_FromLong(envelope->attack_length));
-    PyDict_SetItemString(pyenvelope, "attack_level",  PyInt_FromLong(envelope->attack_level));
-    PyDict_SetItemString(pyenvelope, "fade_length",   PyInt_FromLong(envelope->fade_length));
-    PyDict_SetItemString(pyenvelope, "fade_level",    PyInt_FromLong(envelope->fade_level));
-    return pyenvelope;
-}
-
-PyObject *vjoy_convert_ff_effect(struct ff_effect *effect) {
-    PyObject *pyeffect  = PyDict_New();
-    PyDict_SetItemString(pyeffect,  "type",      PyInt_FromLong(effect->type));
-    PyDict_SetItemString(pyeffect,  "id",        PyInt_FromLong(effect->id));
-    PyDict_SetItemString(pyeffect,  "direction", PyInt_FromLong(effect->direction));
-    PyObject *pytrigger = PyDict_New();
-    PyDict_SetItemString(pytrigger, "button",    PyInt_FromLong(effect->trigger.button));
-    PyDict_SetItemString(pytrigger, "interval",  PyInt_FromLong(effect->trigger.interval));
-    PyDict_SetItemString(pyeffect,  "trigger",   pytrigger);
-    PyObject *pyreplay  = PyDict_New();
-    PyDict_SetItemString(pyreplay,  "length",    PyInt_FromLong(effect->replay.length));
-    PyDict_SetItemString(pyreplay,  "delay",     PyInt_FromLong(effect->replay.delay));
-    PyDict_SetItemString(pyeffect,  "replay",    pyreplay);
-
-    PyObject *pysubeffect[2] = {NULL, NULL};
-    switch (effect->type) {
-        case FF_CONSTANT:
-            pysubeffect[0] = PyDict_New();
-            PyDict_SetItemString(pysubeffect[0], "level",    PyInt_FromLong(effect->u.constant.level));
-            PyDict_SetItemString(pysubeffect[0], "envelope", vjoy_convert_ff_envelope(&effect->u.constant.envelope));
-            PyDict_SetItemString(pyeffect,   "constant", pysubeffect[0]);
+            batch[batchlen].type  = evt->type;
+            batch[batchlen].code  = evt->code;
+            batch[batchlen].value = evt->value;
+            batchlen++;
+        }
+        // The watch is level-triggered, a short read means the queue is empty
+        if (count < VJOY_READ_BATCH) {
             break;
-        case FF_PERIODIC:
-            pysubeffect[0] = PyDict_New();
-            PyDict_SetItemString(pysubeffect[0], "waveform",  PyInt_FromLong(effect->u.periodic.waveform));
-            PyDict_SetItemString(pysubeffect[0], "period",    PyInt_FromLong(effect->u.periodic.period));
-            PyDict_SetItemString(pysubeffect[0], "magnitude", PyInt_FromLong(effect->u.periodic.magnitude));
-            PyDict_SetItemString(pysubeffect[0], "offset",    PyInt_FromLong(effect->u.periodic.offset));
-            PyDict_SetItemString(pysubeffect[0], "phase",     PyInt_FromLong(effect->u.periodic.phase));
-            PyDict_SetItemString(pysubeffect[0], "envelope",  vjoy_convert_ff_envelope(&effect->u.periodic.envelope));
-            PyDict_SetItemString(pyeffect,   "periodic",  pysubeffect[0]);
+        }
+        if (dev->eventsink == VJOY_EVENTS_NONE) {
+            batchlen = 0;
+        } else if (batchlen > 0) {
+            int done = vjoy_dev_deliver_events(dev, batch, batchlen, 0);
+            // A whole read without a SYN_REPORT is passed on as it is
+            if (batchlen - done >= VJOY_READ_BATCH) {
+                done += vjoy_dev_deliver_events(dev, batch + done, batchlen - done, 1);
+            }
+            memmove(batch, batch + done, (batchlen - done) * sizeof(vjoy_packed_event));
+            batchlen -= done;
+        }
+    }
+    if (batchlen > 0 && dev->eventsink != VJOY_EVENTS_NONE) {
+        vjoy_dev_deliver_events(dev, batch, batchlen, 1);
+    }
+    // Without a tick nothing else would mix effects or pass feedback notices on
+    if (dev->leader->devinfo.rate == 0) {
+        vjoy_group_ff_evaluate(dev->leader, vjoy_ff_now());
+    }
+    if (dev->leader->devinfo.rate == 0 && vjoy_group_ff_pending(dev->leader)) {
+        vjoy_py_enter(dev);
+            vjoy_group_ff_deliver(dev->leader);
+        vjoy_py_leave(dev);
+    }
+}
+
+// Submit every staged event with as few write() calls as the kernel allows
+static void vjoy_dev_flush(vjoy_dev *dev) {
+    size_t  total = dev->framelen * sizeof(struct input_event);
+    size_t  done  = 0;
+    char   *buf   = (char*)dev->frame;
+    int     calls = 0;
+    if (dev->capture != NULL) {
+        vjoy_capture_frame_write(dev, dev->frame, dev->framelen);
+    }
+    while (done < total) {
+        ssize_t s = dev->backend->write(dev, buf + done, total - done);
+        if (s < 0) {
+            if (errno == EINTR) continue;
+            static vjoy_log_limit writeerr;
+            vjoy_log_limited(&writeerr, VJOY_LOG_ERROR, "Error writing events to uinput: %s", strerror(errno));
+            break;
+        }
+        // Backends report what they consumed, uinput only whole events
+        done += s;
+        calls++;
+        if (s == 0) break;
+    }
+    vjoy_stat_add(&dev->writecount, calls);
+    vjoy_stat_add(&dev->stats.syscalls, calls);
+    vjoy_stat_add(&dev->stats.eventsout, done / sizeof(struct input_event));
+    if (dev->framelen > calls) {
+        vjoy_stat_add(&dev->writesaved, dev->framelen - calls);
+    }
+    dev->framelen = 0;
+}
+
+vjoy_dev *vjoy_get_device(int id) {
+    if (id < 0 || id >= VJOY_MAX_DEVICES) {
+        return NULL;
+    }
+    return __atomic_load_n(&devices[id], __ATOMIC_ACQUIRE);
+}
+
+// Append an event to the device's frame, flushing early if it is full
+static void vjoy_dev_append(vjoy_dev *dev, int type, int code, int value) {
+    if (dev->framelen >= VJOY_FRAME_MAX) {
+        vjoy_dev_flush(dev);
+    }
+    struct input_event *evt = &dev->frame[dev->framelen++];
+    evt->time  = dev->frametime;
+    evt->type  = type;
+    evt->code  = code;
+    evt->value = value;
+}
+
+/* Stage an event, dropping anything that would not change the device's
+ * state: repeated axis values and key states are suppressed, relative
+ * motion is summed until the SYN_REPORT, and empty frames are never sent.
+ * Events staged outside of a think() go out with the next tick's frame.
+ */
+void vjoy_dev_emit(vjoy_dev *dev, int type, int code, int value) {
+    switch (type) {
+        case EV_ABS:
+            if (code >= 0 && code < ABS_CNT) {
+                if (dev->absstate[code] == value) {
+                    vjoy_stat_add(&dev->suppressed, 1);
+                    return;
+                }
+                dev->absstate[code] = value;
+            }
             break;
-        case FF_RAMP:
-            pysubeffect[0] = PyDict_New();
-            PyDict_SetItemString(pysubeffect[0],   "start_level", PyInt_FromLong(effect->u.ramp.start_level));
-            PyDict_SetItemString(pysubeffect[0],   "end_level",   PyInt_FromLong(effect->u.ramp.end_level));
-            PyDict_SetItemString(pysubeffect[0],   "envelope",    vjoy_convert_ff_envelope(&effect->u.ramp.envelope));
-            PyDict_SetItemString(pyeffect, "ramp",        pysubeffect[0]);
+        case EV_KEY:
+            // Autorepeat (value 2) is always forwarded
+            if (code >= 0 && code < KEY_CNT && (value == 0 || value == 1)) {
+                unsigned long *word = &dev->keystate[code / VJOY_LONG_BITS];
+                unsigned long  bit  = 1UL << (code % VJOY_LONG_BITS);
+                if (((*word & bit) != 0) == value) {
+                    vjoy_stat_add(&dev->suppressed, 1);
+                    return;
+                }
+                *word ^= bit;
+            }
             break;
-        case FF_SPRING:
-        case FF_FRICTION:
-            pysubeffect[0] = PyDict_New();
-            pysubeffect[1] = PyDict_New();
-            PyDict_SetItemString(pysubeffect[0], "right_saturation", PyInt_FromLong(effect->u.condition[0].right_saturation));
-            PyDict_SetItemString(pysubeffect[0], "left_saturation",  PyInt_FromLong(effect->u.condition[0].left_saturation));
-            PyDict_SetItemString(pysubeffect[0], "right_coeff",      PyInt_FromLong(effect->u.condition[0].right_coeff));
-            PyDict_SetItemString(pysubeffect[0], "left_coeff",       PyInt_FromLong(effect->u.condition[0].left_coeff));
-            PyDict_SetItemString(pysubeffect[0], "deadband",         PyInt_FromLong(effect->u.condition[0].deadband));
-            PyDict_SetItemString(pysubeffect[0], "center",           PyInt_FromLong(effect->u.condition[0].center));
-            PyDict_SetItemString(pysubeffect[1], "right_saturation", PyInt_FromLong(effect->u.condition[1].right_saturation));
-            PyDict_SetItemString(pysubeffect[1], "left_saturation",  PyInt_FromLong(effect->u.condition[1].left_saturation));
-            PyDict_SetItemString(pysubeffect[1], "right_coeff",      PyInt_FromLong(effect->u.condition[1].right_coeff));
-            PyDict_SetItemString(pysubeffect[1], "left_coeff",       PyInt_FromLong(effect->u.condition[1].left_coeff));
-            PyDict_SetItemString(pysubeffect[1], "deadband",         PyInt_FromLong(effect->u.condition[1].deadband));
-            PyDict_SetItemString(pysubeffect[1], "center",           PyInt_FromLong(effect->u.condition[1].center));
-            PyDict_SetItemString(pyeffect,       "condition",        PyTuple_Pack(2, pysubeffect[0], pysubeffect[1]));
+        case EV_REL:
+            if (code >= 0 && code < REL_CNT) {
+                if (dev->relmask & (1UL << code)) {
+                    vjoy_stat_add(&dev->suppressed, 1);
+                }
+                dev->relpending[code] += value;
+                dev->relmask          |= 1UL << code;
+                return;
+            }
             break;
-        case FF_RUMBLE:
-            pysubeffect[0] = PyDict_New();
-            PyDict_SetItemString(pysubeffect[0], "strong_magnitude", PyInt_FromLong(effect->u.rumble.strong_magnitude));
-            PyDict_SetItemString(pysubeffect[0], "weak_magnitude",   PyInt_FromLong(effect->u.rumble.weak_magnitude));
-            PyDict_SetItemString(pyeffect, "rumble",           pysubeffect[0]);
+        case EV_SYN:
+            if (code == SYN_REPORT) {
+                for (int i=0; dev->relmask != 0 && i<REL_CNT; i++) {
+                    if (dev->relmask & (1UL << i)) {
+                        if (dev->relpending[i] != 0) {
+                            vjoy_dev_append(dev, EV_REL, i, dev->relpending[i]);
+                            dev->framedirty++;
+                        } else {
+                            vjoy_stat_add(&dev->suppressed, 1);
+                        }
+                        dev->relpending[i] = 0;
+                        dev->relmask      &= ~(1UL << i);
+                    }
+                }
+                if (dev->framedirty == 0) {
+                    vjoy_stat_add(&dev->emptyframes, 1);
+                    return;
+                }
+                vjoy_dev_append(dev, type, code, value);
+                dev->framedirty = 0;
+                return;
+            }
             break;
         default:
             break;
-     }
-     return pyeffect;
+    }
+    vjoy_dev_append(dev, type, code, value);
+    dev->framedirty++;
 }
 
-int  vjoy_initialize() {
-    printf("Initializing...\n");
+// Stage packed (type, code, value) records straight from a buffer
+static int vjoy_dev_stage_packed(vjoy_dev *dev, const char *data,
+                                 Py_ssize_t len, Py_ssize_t itemsize) {
+    if (itemsize == sizeof(int16_t)) {
+        // Triplets of shorts, e.g. array.array('h') or an (N, 3) int16 array
+        if (len % (3 * sizeof(int16_t)) != 0) {
+            PyErr_SetString(PyExc_ValueError, "Packed short events must come in (type, code, value) triplets");
+            return -1;
+        }
+        for (Py_ssize_t i=0; i<len; i+=3*sizeof(int16_t)) {
+            int16_t rec[3];
+            memcpy(rec, data + i, sizeof(rec));
+            vjoy_dev_emit(dev, (uint16_t)rec[0], (uint16_t)rec[1], rec[2]);
+        }
+        return 0;
+    }
+    if (len % sizeof(vjoy_packed_event) != 0) {
+        PyErr_Format(PyExc_ValueError, "Packed events must be %i byte records laid out as vjoy.EVENT_FORMAT",
+                     (int)sizeof(vjoy_packed_event));
+        return -1;
+    }
+    for (Py_ssize_t i=0; i<len; i+=sizeof(vjoy_packed_event)) {
+        vjoy_packed_event rec;
+        memcpy(&rec, data + i, sizeof(rec));
+        vjoy_dev_emit(dev, rec.type, rec.code, rec.value);
+    }
+    return 0;
+}
+
+/* Stage a frame handed back by a module: None (events were already staged
+ * through the native API), any object exporting a buffer of packed records,
+ * or a sequence of (type, code, value) sequences.  A multi-device module
+ * tags events for its other devices as (index, type, code, value); packed
+ * records always go to dev.  Must hold the GIL.
+ */
+static void vjoy_dev_stage_frame(vjoy_dev *dev, PyObject *pyevents) {
+    if (pyevents == NULL || pyevents == Py_None) {
+        return;
+    }
+    if (PyObject_CheckBuffer(pyevents)) {
+        Py_buffer view;
+        if (PyObject_GetBuffer(pyevents, &view, PyBUF_FULL_RO) < 0) {
+            vjoy_py_log_error();
+            return;
+        }
+        if (!PyBuffer_IsContiguous(&view, 'C')) {
+            PyErr_SetString(PyExc_ValueError, "Packed event buffers must be C-contiguous");
+        } else {
+            vjoy_dev_stage_packed(dev, view.buf, view.len, view.itemsize);
+        }
+        PyBuffer_Release(&view);
+        if (PyErr_Occurred() != NULL) {
+            vjoy_py_log_error();
+        }
+        return;
+    }
+    if (!PySequence_Check(pyevents) && PyObject_CheckReadBuffer(pyevents)) {
+        // Old-style buffers, notably array.array on Python 2
+        const void *data;
+        Py_ssize_t  len, itemsize = 1;
+        PyObject   *pyitemsize = PyObject_GetAttrString(pyevents, "itemsize");
+        if (pyitemsize != NULL) {
+            itemsize = PyInt_AsSsize_t(pyitemsize);
+            Py_DECREF(pyitemsize);
+        }
+        PyErr_Clear();
+        if (PyObject_AsReadBuffer(pyevents, &data, &len) < 0 ||
+            vjoy_dev_stage_packed(dev, data, len, itemsize) < 0) {
+            vjoy_py_log_error();
+        }
+        return;
+    }
+    int eventcount = PySequence_Size(pyevents);
+    if (eventcount < 0) {
+        vjoy_py_log_error();
+    }
+    // TODO: This all needs more error checking
+    for (int i=0; i<eventcount; i++) {
+        PyObject *pyevent = PySequence_GetItem(pyevents, i);
+        int       item[4] = {0, 0, 0, 0};
+        if (pyevent == NULL) {
+            continue;
+        }
+        int size = PySequence_Size(pyevent);
+        if (size != 3 && (size != 4 || dev->membercount <= 1)) {
+            static vjoy_log_limit formaterr;
+            vjoy_log_limited(&formaterr, VJOY_LOG_ERROR, dev->membercount > 1 ?
+                             "Event lists must be in the form (type, code, value) or (index, type, code, value)" :
+                             "Event lists must have exactly three items in the form (type, code, value)");
+            PyErr_Clear();
+            Py_DECREF(pyevent);
+            continue;
+        }
+        for (int j=0; j<size; j++) {
+            PyObject *pyitem = PySequence_GetItem(pyevent, j);
+            if (pyitem != NULL) {
+                item[j] = PyInt_AsLong(pyitem);
+                Py_DECREF(pyitem);
+            }
+        }
+        Py_DECREF(pyevent);
+        if (size == 3) {
+            vjoy_dev_emit(dev, item[0], item[1], item[2]);
+        } else if (item[0] >= 0 && item[0] < dev->membercount) {
+            vjoy_dev_emit(dev->members[item[0]], item[1], item[2], item[3]);
+        } else {
+            static vjoy_log_limit indexerr;
+            vjoy_log_limited(&indexerr, VJOY_LOG_ERROR, "Event for device index %i, the module only has %i.",
+                             item[0], dev->membercount);
+        }
+    }
+}
+
+// Start a frame on every device of the group, all sharing one timestamp
+static void vjoy_group_begin(vjoy_dev *dev) {
+    gettimeofday(&dev->frametime, NULL);
+    for (int i=1; i<dev->membercount; i++) {
+        dev->members[i]->frametime = dev->frametime;
+    }
+}
+
+// End the frame of every device of the group and write them out in one pass
+static void vjoy_group_submit(vjoy_dev *dev) {
+    for (int i=0; i<dev->membercount; i++) {
+        if (dev->members[i]->shm != NULL) {
+            vjoy_shm_consume(dev->members[i]);
+        }
+        vjoy_transform_apply(dev->members[i]);
+        // Terminate the frame; a no-op if it is empty or already ended by vjoy.syn()
+        vjoy_dev_emit(dev->members[i], EV_SYN, SYN_REPORT, 0);
+    }
+    // Write without the GIL so a slow uinput never stalls other devices
+    for (int i=0; i<dev->membercount; i++) {
+        vjoy_dev_flush(dev->members[i]);
+    }
+}
+
+/* Call think(), or resume the generator it returned last time until that
+ * one is exhausted.  The generator is sent what woke it up, if anything.
+ */
+static PyObject *vjoy_dev_call_think(vjoy_dev *dev) {
+    PyObject *result;
+    if (dev->thinkgen == NULL) {
+        result = PyObject_CallMethod(dev->pymodule, "doVJoyThink", NULL);
+        if (result == NULL || !PyGen_Check(result)) {
+            return result;
+        }
+        dev->thinkgen  = result;
+        dev->wakeready = -1;
+    }
+    // send(None) is next(), which skips the method lookup on every tick
+    if (dev->wakeready < 0) {
+        result = Py_TYPE(dev->thinkgen)->tp_iternext(dev->thinkgen);
+    } else {
+        result = PyObject_CallMethod(dev->thinkgen, "send", "O", dev->wakeready ? Py_True : Py_False);
+    }
+    dev->wakeready = -1;
+    if (result == NULL) {
+        // Done, or raised; think() is called afresh at the next tick
+        if (PyErr_ExceptionMatches(PyExc_StopIteration)) {
+            PyErr_Clear();
+        }
+        Py_CLEAR(dev->thinkgen);
+    }
+    return result;
+}
+
+/* Whether the group has work of its own to do every tick, without think():
+ * shared memory to drain, raw samples to transform or effects to play.
+ */
+static int vjoy_group_native_ticks(vjoy_dev *dev) {
+    for (int i=0; i<dev->membercount; i++) {
+        vjoy_dev *member = dev->members[i];
+        if (member->shm != NULL || member->devinfo.feedbackcount > 0 ||
+            member->transform.axiscount > 0 || member->transform.bitcount > 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Schedule the group's next resume after its generator yielded wake, or a
+ * frame if NULL.  A frame means the next tick; anything else is a one-shot
+ * deadline on resumefd and/or an fd.  Ticks in between skip the generator
+ * but keep the native work going, and stop altogether if there is none.
+ */
+static void vjoy_dev_schedule(vjoy_dev *dev, const vjoy_py_wake *wake) {
+    // A reload published in the meantime swaps at the next tick, keep ticking
+    if (__atomic_load_n(&dev->reload, __ATOMIC_ACQUIRE) != NULL) {
+        wake = NULL;
+    }
+    if (wake != NULL && dev->resumefd < 0 && dev->reactor != NULL) {
+        dev->resumefd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+        if (dev->resumefd >= 0 &&
+            vjoy_reactor_watch(dev->reactor, &dev->resumewatch, VJOY_WATCH_RESUME, dev->resumefd, dev) < 0) {
+            close(dev->resumefd);
+            dev->resumefd = -1;
+        }
+    }
+    if (wake != NULL && dev->resumefd < 0) {
+        static vjoy_log_limit resumeerr;
+        vjoy_log_limited(&resumeerr, VJOY_LOG_ERROR, "Device %i cannot sleep: %s", dev->id,
+                         dev->reactor == NULL ? "no reactor" : strerror(errno));
+        wake = NULL;
+    }
+    if (wake != NULL && wake->fd >= 0) {
+        if (dev->reactor == NULL ||
+            vjoy_reactor_watch(dev->reactor, &dev->waitwatch, VJOY_WATCH_WAIT, wake->fd, dev) < 0) {
+            static vjoy_log_limit waiterr;
+            vjoy_log_limited(&waiterr, VJOY_LOG_ERROR, "Device %i cannot wait on fd %i: %s",
+                             dev->id, wake->fd, dev->reactor == NULL ? "no reactor" : strerror(errno));
+            dev->waitwatch.fd = -1;
+            // Treated as timed out at the next tick
+            dev->wakeready = 0;
+            wake = NULL;
+        }
+    }
+    if (wake == NULL) {
+        if (dev->asleep) {
+            __atomic_store_n(&dev->asleep, 0, __ATOMIC_RELAXED);
+            vjoy_dev_unwait(dev);
+            vjoy_timer_arm_once(dev->resumefd, 0);
+            if (!vjoy_group_native_ticks(dev)) {
+                vjoy_dev_arm_timer(dev, 1);
+            }
+        }
+        return;
+    }
+    long long deadline = 0;
+    if (wake->deadline >= 0) {
+        deadline = wake->deadline * 1e9;
+        deadline = deadline > 0 ? deadline : 1;
+    }
+    vjoy_timer_arm_once(dev->resumefd, deadline);
+    if (!dev->asleep && !vjoy_group_native_ticks(dev)) {
+        vjoy_timer_arm_once(dev->tickfd, 0);
+    }
+    __atomic_store_n(&dev->asleep, 1, __ATOMIC_RELAXED);
+}
+
+/* Run one tick of the group and submit its frames; think() only runs when
+ * resume is set, i.e. unless its generator sleeps past this tick.
+ */
+static void vjoy_group_tick(vjoy_dev *dev, int resume) {
+    PyObject           *pyevents;
+    long long           now = vjoy_ff_now();
+    vjoy_py_wake        wake;
+    int                 sleeps = 0;
+    int                 thinks = dev->hasthink && resume;
+    vjoy_group_begin(dev);
+    // Mix force feedback so think() sees this tick's output via vjoy.get_force()
+    vjoy_group_ff_evaluate(dev, now);
+    if (!thinks && vjoy_group_ff_pending(dev)) {
+        vjoy_py_enter(dev);
+            vjoy_group_ff_deliver(dev);
+        vjoy_py_leave(dev);
+    }
+    if (thinks) {
+        vjoy_py_enter(dev);
+            // Feedback answered since the last tick, before think() acts on it
+            vjoy_group_ff_deliver(dev);
+            unsigned long long started = vjoy_stats_now();
+            pyevents = vjoy_dev_call_think(dev);
+            if (PyErr_Occurred() != NULL) {
+                vjoy_py_log_error();
+            }
+            if (pyevents != NULL && Py_TYPE(pyevents) == &vjoy_py_wake_type) {
+                wake   = *(vjoy_py_wake*)pyevents;
+                sleeps = 1;
+            } else {
+                vjoy_dev_stage_frame(dev, pyevents);
+            }
+            Py_XDECREF(pyevents);
+            vjoy_hist_record(&dev->stats.think, vjoy_stats_now() - started);
+        vjoy_py_leave(dev);
+        vjoy_dev_schedule(dev, sleeps ? &wake : NULL);
+    }
+    vjoy_group_submit(dev);
+}
+
+/* Run one tick of the device's think() and submit the resulting frame,
+ * along with those of the rest of its group.  Members tick with the leader.
+ */
+void vjoy_dev_think(vjoy_dev *dev) {
+    if (dev->leader != dev) {
+        return;
+    }
+    vjoy_group_tick(dev, !dev->asleep);
+}
+
+/* A watched descriptor is readable: let the module read it and send the
+ * resulting frame right away instead of waiting for the next tick.
+ */
+void vjoy_dev_read_ready(vjoy_dev *dev, vjoy_watch *watch, int events) {
+    int       fd = watch->fd;
+    PyObject *pyevents;
+    if (fd < 0) {
+        return; // Unwatched earlier in this epoll batch
+    }
+    vjoy_group_begin(dev);
+    // Modules running on their fds call vjoy.get_force() from here, not think()
+    vjoy_group_ff_evaluate(dev, vjoy_ff_now());
+    vjoy_py_enter(dev);
+        pyevents = PyObject_CallMethod(dev->pymodule, "doVJoyRead", "i", fd);
+        if (PyErr_Occurred() != NULL) {
+            vjoy_py_log_error();
+        }
+        vjoy_dev_stage_frame(dev, pyevents);
+        Py_XDECREF(pyevents);
+    vjoy_py_leave(dev);
+    vjoy_stat_add(&dev->stats.reads, 1);
+    // A hung up descriptor stays readable forever; stop watching it
+    if ((events & (EPOLLHUP | EPOLLERR)) && !(events & EPOLLIN) && watch->fd == fd) {
+        vjoy_log(VJOY_LOG_WARN, "fd %i of device %i hung up, no longer watching it.", fd, dev->id);
+        vjoy_dev_unwatch_fd(dev, fd);
+    }
+    vjoy_group_submit(dev);
+}
+
+// The fd a doVJoyThink() generator waits on is readable, resume it now
+void vjoy_dev_wait_ready(vjoy_dev *dev) {
+    if (dev->waitwatch.fd < 0) {
+        return; // Timed out earlier in this epoll batch
+    }
+    vjoy_dev_unwait(dev);
+    dev->wakeready = 1;
+    vjoy_group_tick(dev, 1);
+    vjoy_stat_add(&dev->stats.ticks, 1);
+}
+
+// The deadline a doVJoyThink() generator slept until has come
+void vjoy_dev_resume_ready(vjoy_dev *dev) {
+    uint64_t expirations;
+    if (read(dev->resumefd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+        return; // Rescheduled earlier in this epoll batch
+    }
+    // Waiting on an fd as well, which timed out
+    if (dev->waitwatch.fd >= 0) {
+        vjoy_dev_unwait(dev);
+        dev->wakeready = 0;
+    }
+    vjoy_group_tick(dev, 1);
+    vjoy_stat_add(&dev->stats.ticks, 1);
+}
+
+/* A physical source is readable: remap everything it has queued into its
+ * device's frame and write it out, entering Python only for events the
+ * module subscribed to.  Their handler may return events like think().
+ */
+void vjoy_dev_source_ready(vjoy_dev *dev, vjoy_watch *watch) {
+    int                i      = watch - dev->sourcewatches;
+    vjoy_dev          *target = dev->members[dev->devinfo.sources[i].device];
+    vjoy_packed_event  subs[VJOY_READ_BATCH];
+    int                subcount, more;
+    if (dev->sources[i] == NULL) {
+        return; // Closed earlier in this epoll batch
+    }
+    vjoy_group_begin(dev);
+    do {
+        more = vjoy_source_read(dev->sources[i], target, subs, &subcount);
+        if (subcount > 0) {
+            vjoy_group_ff_evaluate(dev, vjoy_ff_now());
+            vjoy_py_enter(dev);
+                for (int e=0; e<subcount; e++) {
+                    PyObject *pyevents = PyObject_CallMethod(dev->pymodule, "doVJoySourceEvent", "iiii",
+                                                             i, subs[e].type, subs[e].code, subs[e].value);
+                    if (PyErr_Occurred() != NULL) {
+                        vjoy_py_log_error();
+                    }
+                    vjoy_dev_stage_frame(dev, pyevents);
+                    Py_XDECREF(pyevents);
+                }
+            vjoy_py_leave(dev);
+        }
+    } while (more > 0);
+    // Unplugged: stop watching it, the module keeps running without it
+    if (more < 0) {
+        vjoy_dev_close_source(dev, i);
+    }
+    vjoy_group_submit(dev);
+}
+
+void vjoy_dev_input_ready(vjoy_dev *dev) {
+    uint64_t expirations;
+    ssize_t  s = read(dev->tickfd, &expirations, sizeof(expirations));
+    vjoy_stat_add(&dev->stats.syscalls, 1);
+    if (s != sizeof(expirations)) {
+        if (s < 0 && (errno == EINTR || errno == EAGAIN)) return;
+        static vjoy_log_limit tickerr;
+        vjoy_log_limited(&tickerr, VJOY_LOG_ERROR, "Error reading tick timer.");
+        return;
+    }
+    // Modules are only ever swapped between ticks
+    if (__atomic_load_n(&dev->reload, __ATOMIC_RELAXED) != NULL) {
+        vjoy_dev_swap(dev);
+        if (dev->devinfo.rate == 0) {
+            return; // Woken up only for the swap
+        }
+    }
+    int ticks = 1;
+    if (expirations > 1) {
+        vjoy_stat_add(&dev->overruns, 1);
+        vjoy_stat_add(&dev->missed, expirations - 1);
+        if (dev->devinfo.catchup == VJOY_CATCHUP_BURST) {
+            ticks = expirations < VJOY_BURST_MAX ? expirations : VJOY_BURST_MAX;
+        }
+    }
+    for (int i=0; i<ticks; i++) {
+        vjoy_dev_think(dev);
+    }
+    vjoy_stat_add(&dev->stats.ticks, ticks);
+}
+
+int  vjoy_initialize(int threads) {
+    vjoy_log(VJOY_LOG_INFO, "Initializing...");
     Py_Initialize();
-    assert(pthread_mutex_init(&pymutex, NULL) == 0);
-    char modulepath[4096];
-    snprintf(modulepath, 4096, "%s:%s/.config/vjoy/modules/", Py_GetPath(), getenv("HOME"));
-    printf("Searching for modules in %s/.config/vjoy/modules/ (as well as other Python paths)\n", getenv("HOME"));
+    PyEval_InitThreads();
+    // Extra module directories, searched first, e.g. VJOYPATH=. for the benchmarks
+    const char *extra = getenv("VJOYPATH");
+    if (extra != NULL && extra[0] != '\0') {
+        snprintf(modulepath, 4096, "%s:%s:%s/.config/vjoy/modules/", extra, Py_GetPath(), getenv("HOME"));
+        vjoy_log(VJOY_LOG_INFO, "Searching for modules in %s first", extra);
+    } else {
+        snprintf(modulepath, 4096, "%s:%s/.config/vjoy/modules/", Py_GetPath(), getenv("HOME"));
+    }
+    vjoy_log(VJOY_LOG_INFO, "Searching for modules in %s/.config/vjoy/modules/ (as well as other Python paths)", getenv("HOME"));
     PySys_SetPath(modulepath);
     vjoy_py_initialize();
-    printf("Finished initialization.\n");
+    // Release the GIL; from here on it is taken per device interpreter
+    mainstate = PyEval_SaveThread();
+
+    // Every device is multiplexed onto this fixed pool of reactor threads
+    if (threads < 0) threads = 0;
+    if (threads > VJOY_REACTOR_MAX) threads = VJOY_REACTOR_MAX;
+    vjoy_log(VJOY_LOG_INFO, "Starting %i reactor thread(s).", threads);
+    for (reactorcount=0; reactorcount<threads; reactorcount++) {
+        vjoy_reactor *reactor = &reactors[reactorcount];
+        reactor->epfd   = epoll_create1(EPOLL_CLOEXEC);
+        reactor->wakefd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (reactor->epfd < 0 || reactor->wakefd < 0 ||
+            vjoy_reactor_watch(reactor, &reactor->wakewatch, VJOY_WATCH_WAKE, reactor->wakefd, NULL) < 0) {
+            vjoy_log(VJOY_LOG_ERROR, "Failed to create reactor: %s", strerror(errno));
+            return -1;
+        }
+        pthread_create(&reactor->thread, NULL, vjoy_reactor_loop, reactor);
+    }
+    vjoy_log(VJOY_LOG_INFO, "Finished initialization.");
     return 0;
 }
+
+// Finish anything that must survive the process exiting, e.g. captures
+void vjoy_shutdown() {
+    for (int id=0; id<VJOY_MAX_DEVICES; id++) {
+        vjoy_dev *dev = vjoy_get_device(id);
+        if (dev != NULL) {
+            // Reactors are still running, so the capture is only finished
+            // and shared memory only unlinked; exiting unmaps it
+            vjoy_capture_finish(dev);
+            vjoy_shm_unlink(dev);
+        }
+    }
+}
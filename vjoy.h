@@ -1,13 +1,31 @@
 #ifndef _VJOY_H
 #define _VJOY_H
 
+#include <Python.h> // Must come first, it sets the feature test macros
 #include <linux/input.h>
 #include <linux/uinput.h>
-#include <Python.h>
 #include <pthread.h>
+#include "vjoy_ff.h"
+#include "vjoy_log.h"
+#include "vjoy_stats.h"
+#include "vjoy_backend.h"
+#include "vjoy_transform.h"
+#include "vjoy_source.h"
 
-#define VJOY_INPUT_RATE  60 // Loop input frequency in Hertz
-#define VJOY_INPUT_DELAY 1000000/VJOY_INPUT_RATE
+#define VJOY_INPUT_RATE  60 // Default loop input frequency in Hertz
+#define VJOY_BURST_MAX   8  // Most missed ticks replayed at once when catching up
+#define VJOY_MAX_DEVICES 1024 // Capacity of the device table
+#define VJOY_REACTOR_MAX 64 // Upper bound on reactor threads
+#define VJOY_EPOLL_BATCH 64 // Ready file descriptors handled per epoll_wait()
+#define VJOY_READ_BATCH  64 // Events taken from uinput per read()
+#define VJOY_FRAME_MAX   256 // Maximum events staged per frame, SYN_REPORT included
+#define VJOY_FD_MAX      16 // Module file descriptors watched per device
+#define VJOY_GROUP_MAX   16 // Devices one module can declare with 'devices'
+
+typedef enum _vjoy_catchup {
+    VJOY_CATCHUP_SKIP,  // Drop missed ticks and resume on the next deadline
+    VJOY_CATCHUP_BURST  // Run missed ticks back to back, up to VJOY_BURST_MAX
+} vjoy_catchup;
 
 typedef struct _vjoy_info {
     char name[UINPUT_MAX_NAME_SIZE];
@@ -15,27 +33,138 @@ typedef struct _vjoy_info {
     int  relaxiscount;
     int  absaxis[ABS_CNT];
     int  absaxiscount;
+    struct input_absinfo absinfo[ABS_CNT]; // Range, fuzz, flat and resolution per axis
     int  feedback[FF_CNT];
     int  feedbackcount;
     int  maxeffects;
     int  buttons[KEY_CNT];
     int  buttoncount;
+    double       rate;    // Input loop frequency in Hertz, 0 to only run on fds
+    vjoy_catchup catchup; // What to do with ticks missed by a slow think()
+    int          fds[VJOY_FD_MAX]; // Descriptors that wake doVJoyRead()
+    int          fdcount;
+    char         shmname[64]; // Shared memory input region, "" for none
+    vjoy_source_info sources[VJOY_SOURCE_MAX]; // Physical devices remapped natively
+    int              sourcecount;
 } vjoy_info;
 
+#define VJOY_LONG_BITS   (sizeof(unsigned long) * 8)
+#define VJOY_NLONGS(n)   (((n) + VJOY_LONG_BITS - 1) / VJOY_LONG_BITS)
+
+// Packed event record accepted from modules, struct format "=HHi"
+typedef struct _vjoy_packed_event {
+    __u16 type;
+    __u16 code;
+    __s32 value;
+} vjoy_packed_event;
+
+struct _vjoy_dev;
+
+// How events the kernel sends to a device reach its module
+typedef enum _vjoy_event_sink {
+    VJOY_EVENTS_NONE,   // Neither callback is defined, skip Python
+    VJOY_EVENTS_SINGLE, // doVJoyEvent(type, code, value) per event
+    VJOY_EVENTS_BATCH   // doVJoyEvents(batch) per SYN_REPORT-terminated group
+} vjoy_event_sink;
+
+typedef enum _vjoy_watch_kind {
+    VJOY_WATCH_UINPUT, // Events and FF requests sent to the device by the kernel
+    VJOY_WATCH_TICK,   // The device's input loop timer
+    VJOY_WATCH_FD,     // A descriptor the module asked to be woken for
+    VJOY_WATCH_SOURCE, // A physical device remapped by the group, see vjoy_source.c
+    VJOY_WATCH_WAIT,   // A descriptor a doVJoyThink() generator waits on
+    VJOY_WATCH_RESUME, // The deadline a doVJoyThink() generator sleeps until
+    VJOY_WATCH_IDLE,   // A pooled device no module has taken yet, see vjoy_pool.c
+    VJOY_WATCH_WAKE    // The reactor's own eventfd, see vjoy_dev_detach()
+} vjoy_watch_kind;
+
+// A file descriptor registered with a reactor, handed back by epoll_wait()
+typedef struct _vjoy_watch {
+    vjoy_watch_kind   kind;
+    int               fd;
+    struct _vjoy_dev *dev;
+} vjoy_watch;
+
+typedef struct _vjoy_reactor {
+    int           epfd;      // epoll instance multiplexing every watch of its devices
+    pthread_t     thread;    // Thread running vjoy_reactor_loop()
+    int           wakefd;    // eventfd ending an idle epoll_wait()
+    vjoy_watch    wakewatch;
+    unsigned long batches;   // epoll_wait() batches fully handled
+} vjoy_reactor;
+
 typedef struct _vjoy_dev {
-    int                    uifd;       // UInput File Descriptor
+    int                    id;         // Index in the device table, VJoyID in Python
+    int                    uifd;       // UInput File Descriptor, or the backend's output
+    const vjoy_backend    *backend;    // Where frames are written
     struct uinput_user_dev uidev;      // UInput Device Info
     PyObject              *pymodule;   // The Python script that operates this device
+    PyThreadState         *pystate;    // Thread state of the device's own interpreter
+    char                   modname[256]; // Name the module was imported as
+    int                    hasthink;   // The module defines doVJoyThink()
+    PyObject              *thinkgen;   // Leader only: generator doVJoyThink() returned, resumed until done
+    int                    asleep;     // Leader only: the generator is resumed off the tick
+    int                    resumefd;   // Leader only: timerfd firing at the generator's deadline
+    vjoy_watch             resumewatch;
+    int                    wakeready;  // Sent to the generator: -1 None, 0 timed out, 1 its fd is ready
+    vjoy_watch             waitwatch;  // Leader only: fd the generator waits on, -1 when none
+    vjoy_event_sink        eventsink;  // Which doVJoyEvent*() the module defines
+    struct _vjoy_reload   *reload;     // Leader only: newer module to swap in at the next tick
+    struct _vjoy_dev      *leader;     // Group device owning the interpreter and timer, often itself
+    int                    index;      // Position in the leader's group
+    struct _vjoy_dev      *members[VJOY_GROUP_MAX]; // Leader only: every device of the module, itself first
+    int                    membercount;
     vjoy_info              devinfo;    // The parsed device info
-    pthread_t              evtthread;  // pthread structure for events
-    pthread_t              inptthread; // pthread for device input loop
+    vjoy_reactor          *reactor;    // Reactor thread serving this device
+    vjoy_watch             evtwatch;   // Readiness of uifd
+    vjoy_watch             tickwatch;  // Expiry of tickfd
+    int                    tickfd;     // timerfd firing at devinfo.rate
+    vjoy_watch             fdwatches[VJOY_FD_MAX]; // Module descriptors, fd -1 when free
+    struct _vjoy_source   *sources[VJOY_SOURCE_MAX]; // Leader only: open 'sources', NULL once gone
+    vjoy_watch             sourcewatches[VJOY_SOURCE_MAX];
+    unsigned long          overruns;   // Ticks that found earlier deadlines missed
+    unsigned long          missed;     // Total deadlines missed
+    struct input_event     frame[VJOY_FRAME_MAX]; // Events staged for the next write()
+    int                    framelen;   // Number of events currently staged
+    struct timeval         frametime;  // Timestamp shared by the staged frame
+    int                    framedirty; // Events staged since the last SYN_REPORT
+    int                    absstate[ABS_CNT];              // Last value sent per axis
+    unsigned long          keystate[VJOY_NLONGS(KEY_CNT)]; // Last state sent per key
+    int                    relpending[REL_CNT]; // Deltas accumulated this frame
+    unsigned long          relmask;    // Relative axes with a pending delta
+    vjoy_ff_state          ff;         // Native force feedback playback
+    struct _vjoy_source   *ffsource;   // Physical device its feedback is forwarded to, if any
+    vjoy_transform         transform;  // Raw samples -> axes and buttons, see vjoy_transform.c
+    struct _vjoy_capture  *capture;    // Where flushed frames are recorded, if anywhere
+    struct _vjoy_shm      *shm;        // Shared memory input, see vjoy_shm.h
+    unsigned long          writecount; // write() syscalls issued to uinput
+    unsigned long          writesaved; // write() syscalls avoided by coalescing
+    unsigned long          suppressed; // Events dropped as unchanged or merged
+    unsigned long          emptyframes; // SYN_REPORTs dropped for empty frames
+    vjoy_dev_stats         stats;      // Hot path metrics, see vjoy_stats.c
 } vjoy_dev;
 
 int       vjoy_load_module(char* name);
-void     *vjoy_dev_event_loop(void *arg);
-void     *vjoy_dev_input_loop(void *arg);
-PyObject *vjoy_convert_ff_effect(struct ff_effect *effect);
-PyObject *vjoy_convert_ff_envelope(struct ff_envelope *envelope);
-int       vjoy_initialize();
+int       vjoy_unload_device(int id);
+int       vjoy_module_info(const char *name, vjoy_info *info, int max);
+int       vjoy_info_caps_equal(const vjoy_info *a, const vjoy_info *b);
+void      vjoy_devices_lock();
+void      vjoy_devices_unlock();
+void     *vjoy_reactor_loop(void *arg);
+void      vjoy_dev_event_ready(vjoy_dev *dev);
+void      vjoy_dev_input_ready(vjoy_dev *dev);
+void      vjoy_dev_think(vjoy_dev *dev);
+void      vjoy_dev_read_ready(vjoy_dev *dev, vjoy_watch *watch, int events);
+void      vjoy_dev_source_ready(vjoy_dev *dev, vjoy_watch *watch);
+void      vjoy_dev_wait_ready(vjoy_dev *dev);
+void      vjoy_dev_resume_ready(vjoy_dev *dev);
+int       vjoy_reactor_watch_idle(vjoy_watch *watch, int fd);
+void      vjoy_reactor_unwatch_idle(vjoy_watch *watch);
+int       vjoy_dev_watch_fd(vjoy_dev *dev, int fd);
+int       vjoy_dev_unwatch_fd(vjoy_dev *dev, int fd);
+vjoy_dev *vjoy_get_device(int id);
+void      vjoy_dev_emit(vjoy_dev *dev, int type, int code, int value);
+int       vjoy_initialize(int reactors);
+void      vjoy_shutdown();
 
 #endif /* _VJOY_H */
@@ -0,0 +1,220 @@
+#include "vjoy.h"
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+
+/* Output backends.  Selected once for the whole process with
+ * vjoy_backend_select("uinput"), "null" or "file:DIR".
+ */
+
+static const char *uinputpaths[] = {
+    "/dev/uinput",
+    "/dev/misc/uinput",
+    "/dev/input/uinput"
+};
+
+static char vjoy_backend_dir[4096] = "."; // Output directory of the file backend
+
+static ssize_t vjoy_backend_fd_write(vjoy_dev *dev, const void *buf, size_t len) {
+    return write(dev->uifd, buf, len);
+}
+
+// uinput only consumes whole events, a partial one is reported unwritten
+static ssize_t vjoy_uinput_write(vjoy_dev *dev, const void *buf, size_t len) {
+    ssize_t s = write(dev->uifd, buf, len);
+    return s < 0 ? s : s - s % (ssize_t)sizeof(struct input_event);
+}
+
+static void vjoy_backend_fd_close(vjoy_dev *dev) {
+    if (dev->uifd >= 0) {
+        close(dev->uifd);
+        dev->uifd = -1;
+    }
+}
+
+/* uinput */
+
+static int vjoy_uinput_open(vjoy_dev *dev) {
+    vjoy_log(VJOY_LOG_INFO, "\tInitializing uinput.");
+    int paths = sizeof(uinputpaths)/sizeof(char*);
+    for (int i=0; i<paths; i++) {
+        vjoy_log(VJOY_LOG_INFO, "\t\tTrying %s", uinputpaths[i]);
+        dev->uifd = open(uinputpaths[i], O_RDWR | O_CLOEXEC);
+        if (dev->uifd >= 0) break;
+    }
+    if (dev->uifd < 0) {
+        vjoy_log(VJOY_LOG_INFO, "\tFailed to initialize uinput");
+        return -1;
+    }
+    vjoy_log(VJOY_LOG_INFO, "\tSucceeded!");
+    return 0;
+}
+
+#ifdef UI_DEV_SETUP
+/* Kernels since 4.5 take the device and each axis through ioctls, with
+ * fuzz, flat and resolution that uinput_user_dev has no room for.
+ */
+static int vjoy_uinput_setup(vjoy_dev *dev) {
+    struct uinput_setup setup;
+    memset(&setup, 0, sizeof(setup));
+    setup.id = dev->uidev.id;
+    memcpy(setup.name, dev->uidev.name, UINPUT_MAX_NAME_SIZE);
+    setup.ff_effects_max = dev->uidev.ff_effects_max;
+
+    for (int i=0; i<dev->devinfo.absaxiscount; i++) {
+        struct uinput_abs_setup abs;
+        memset(&abs, 0, sizeof(abs));
+        abs.code    = dev->devinfo.absaxis[i];
+        abs.absinfo = dev->devinfo.absinfo[abs.code];
+        if (ioctl(dev->uifd, UI_ABS_SETUP, &abs) != 0) {
+            return -1;
+        }
+    }
+    return ioctl(dev->uifd, UI_DEV_SETUP, &setup);
+}
+#endif
+
+static int vjoy_uinput_create(vjoy_dev *dev) {
+    dev->uidev.id.bustype = BUS_VIRTUAL;
+
+    if (dev->devinfo.relaxiscount > 0) {
+        ioctl(dev->uifd, UI_SET_EVBIT, EV_REL);
+        for (int i=0; i<dev->devinfo.relaxiscount; i++) {
+            vjoy_log(VJOY_LOG_INFO, "\tAdding relative axis: %x", dev->devinfo.relaxis[i]);
+            ioctl(dev->uifd, UI_SET_RELBIT, dev->devinfo.relaxis[i]);
+        }
+    }
+    if (dev->devinfo.absaxiscount > 0) {
+        ioctl(dev->uifd, UI_SET_EVBIT, EV_ABS);
+        for (int i=0; i<dev->devinfo.absaxiscount; i++) {
+            vjoy_log(VJOY_LOG_INFO, "\tAdding absolute axis: %x", dev->devinfo.absaxis[i]);
+            ioctl(dev->uifd, UI_SET_ABSBIT, dev->devinfo.absaxis[i]);
+        }
+    }
+    if (dev->devinfo.feedbackcount > 0) {
+        ioctl(dev->uifd, UI_SET_EVBIT, EV_FF);
+        for (int i=0; i<dev->devinfo.feedbackcount; i++) {
+            vjoy_log(VJOY_LOG_INFO, "\tAdding feedback effect: %x", dev->devinfo.feedback[i]);
+            ioctl(dev->uifd, UI_SET_FFBIT, dev->devinfo.feedback[i]);
+        }
+    }
+    if (dev->devinfo.buttoncount > 0) {
+        ioctl(dev->uifd, UI_SET_EVBIT, EV_KEY);
+        for (int i=0; i<dev->devinfo.buttoncount; i++) {
+            vjoy_log(VJOY_LOG_INFO, "\tAdding key/button: %x", dev->devinfo.buttons[i]);
+            ioctl(dev->uifd, UI_SET_KEYBIT, dev->devinfo.buttons[i]);
+        }
+    }
+
+    for (int i=0; i<ABS_CNT; i++) {
+        dev->uidev.absmin[i]  = dev->devinfo.absinfo[i].minimum;
+        dev->uidev.absmax[i]  = dev->devinfo.absinfo[i].maximum;
+        dev->uidev.absfuzz[i] = dev->devinfo.absinfo[i].fuzz;
+        dev->uidev.absflat[i] = dev->devinfo.absinfo[i].flat;
+    }
+    dev->uidev.ff_effects_max = dev->devinfo.maxeffects;
+
+    // Older kernels reject the setup ioctls, they get the uinput_user_dev write
+    int created = -1;
+#ifdef UI_DEV_SETUP
+    created = vjoy_uinput_setup(dev);
+    if (created != 0) {
+        vjoy_log(VJOY_LOG_INFO, "\tUI_DEV_SETUP unavailable (%s), using the legacy setup.", strerror(errno));
+    }
+#endif
+    if (created != 0 &&
+        write(dev->uifd, &dev->uidev, sizeof(struct uinput_user_dev)) != sizeof(struct uinput_user_dev)) {
+        vjoy_log(VJOY_LOG_ERROR, "Device creation failed: %s", strerror(errno));
+        return -1;
+    }
+    if (ioctl(dev->uifd, UI_DEV_CREATE) != 0) {
+        vjoy_log(VJOY_LOG_ERROR, "Device creation failed: %s", strerror(errno));
+        return -1;
+    }
+    // The legacy setup has no initial values, move axes that rest elsewhere than 0
+    if (created != 0) {
+        struct input_event rest[ABS_CNT + 1];
+        int                n = 0;
+        memset(rest, 0, sizeof(rest));
+        for (int i=0; i<dev->devinfo.absaxiscount; i++) {
+            int code = dev->devinfo.absaxis[i];
+            if (dev->devinfo.absinfo[code].value != 0) {
+                rest[n].type  = EV_ABS;
+                rest[n].code  = code;
+                rest[n].value = dev->devinfo.absinfo[code].value;
+                n++;
+            }
+        }
+        if (n > 0) {
+            rest[n++].type = EV_SYN;
+            if (write(dev->uifd, rest, n * sizeof(struct input_event)) != (ssize_t)(n * sizeof(struct input_event))) {
+                vjoy_log(VJOY_LOG_WARN, "Failed to move axes to rest: %s", strerror(errno));
+            }
+        }
+    }
+    return 0;
+}
+
+/* null: frames are accepted and thrown away */
+
+static int vjoy_null_open(vjoy_dev *dev) {
+    dev->uifd = -1;
+    return 0;
+}
+
+static int vjoy_null_create(vjoy_dev *dev) {
+    return 0;
+}
+
+static ssize_t vjoy_null_write(vjoy_dev *dev, const void *buf, size_t len) {
+    return len;
+}
+
+static void vjoy_null_close(vjoy_dev *dev) {
+}
+
+/* file: the raw struct input_event stream, one DIR/vjoy<id>.events per device */
+
+static int vjoy_file_open(vjoy_dev *dev) {
+    char path[4096 + 32];
+    snprintf(path, sizeof(path), "%s/vjoy%i.events", vjoy_backend_dir, dev->id);
+    dev->uifd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (dev->uifd < 0) {
+        vjoy_log(VJOY_LOG_ERROR, "Failed to open %s: %s", path, strerror(errno));
+        return -1;
+    }
+    vjoy_log(VJOY_LOG_INFO, "\tWriting events to %s", path);
+    return 0;
+}
+
+static const vjoy_backend vjoy_backends[] = {
+    {"uinput", 1, vjoy_uinput_open, vjoy_uinput_create, vjoy_uinput_write,     vjoy_backend_fd_close},
+    {"null",   0, vjoy_null_open,   vjoy_null_create,   vjoy_null_write,       vjoy_null_close},
+    {"file",   0, vjoy_file_open,   vjoy_null_create,   vjoy_backend_fd_write, vjoy_backend_fd_close},
+};
+
+static const vjoy_backend *vjoy_backend_active = &vjoy_backends[0];
+
+int vjoy_backend_select(const char *spec) {
+    const char *arg  = strchr(spec, ':');
+    size_t      len  = arg != NULL ? (size_t)(arg - spec) : strlen(spec);
+    int         count = sizeof(vjoy_backends)/sizeof(vjoy_backend);
+    for (int i=0; i<count; i++) {
+        if (strlen(vjoy_backends[i].name) == len && strncmp(vjoy_backends[i].name, spec, len) == 0) {
+            if (arg != NULL) {
+                snprintf(vjoy_backend_dir, sizeof(vjoy_backend_dir), "%s", arg + 1);
+            }
+            vjoy_backend_active = &vjoy_backends[i];
+            return 0;
+        }
+    }
+    vjoy_log(VJOY_LOG_ERROR, "Unknown backend %s, expected uinput, null or file:DIR", spec);
+    return -1;
+}
+
+const vjoy_backend *vjoy_backend_current() {
+    return vjoy_backend_active;
+}
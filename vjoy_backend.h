@@ -0,0 +1,23 @@
+#ifndef _VJOY_BACKEND_H
+#define _VJOY_BACKEND_H
+
+#include <sys/types.h>
+
+struct _vjoy_dev;
+
+/* Where a device's frames end up.  uinput is the real thing; the other
+ * backends let vjoy run (and be benchmarked) without /dev/uinput.
+ */
+typedef struct _vjoy_backend {
+    const char *name;
+    int         pollable; // dev->uifd hands back events and FF requests
+    int       (*open)(struct _vjoy_dev *dev);   // Sets dev->uifd, -1 if the backend has none
+    int       (*create)(struct _vjoy_dev *dev); // Apply dev->devinfo and bring the device up
+    ssize_t   (*write)(struct _vjoy_dev *dev, const void *buf, size_t len);
+    void      (*close)(struct _vjoy_dev *dev);
+} vjoy_backend;
+
+int                 vjoy_backend_select(const char *spec);
+const vjoy_backend *vjoy_backend_current();
+
+#endif /* _VJOY_BACKEND_H */
@@ -0,0 +1,470 @@
+#include "vjoy.h"
+#include "vjoy_capture.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/prctl.h>
+
+/* Capture and replay.  Capturing appends every frame a device flushes to
+ * DIR/vjoy<id>.vjcap (vjoy<id>-<n>.vjcap if taken, ids are reused) through
+ * a private buffer; replay maps the files and
+ * streams them into freshly created devices on their original schedule,
+ * without ever starting Python.
+ */
+
+struct _vjoy_capture {
+    pthread_mutex_t     lock;        // Taken by the device's reactor and by close
+    int                 fd;
+    int                 closed;
+    uint64_t            offset;      // File offset of the next byte written
+    uint64_t            framecount;
+    uint64_t            nextindex;   // Capture time of the next index entry
+    vjoy_capture_index *index;
+    uint64_t            indexcount;
+    uint64_t            indexsize;
+    size_t              buflen;
+    char                buf[VJOY_CAPTURE_BUFFER];
+};
+
+static char               vjoy_capture_dir[4096];
+static int                vjoy_capture_enabled = 0;
+static unsigned long long vjoy_capture_epoch   = 0; // Shared so devices line up on replay
+
+int vjoy_capture_start(const char *dir) {
+    snprintf(vjoy_capture_dir, sizeof(vjoy_capture_dir), "%s", dir);
+    vjoy_capture_epoch   = vjoy_stats_now();
+    vjoy_capture_enabled = 1;
+    return 0;
+}
+
+static int vjoy_capture_drain(vjoy_capture *cap) {
+    for (size_t done=0; done<cap->buflen; ) {
+        ssize_t s = write(cap->fd, cap->buf + done, cap->buflen - done);
+        if (s < 0 && errno == EINTR) continue;
+        if (s <= 0) {
+            static vjoy_log_limit writeerr;
+            vjoy_log_limited(&writeerr, VJOY_LOG_ERROR, "Error writing capture: %s", strerror(errno));
+            cap->buflen = 0;
+            return -1;
+        }
+        done += s;
+    }
+    cap->buflen = 0;
+    return 0;
+}
+
+static void vjoy_capture_append(vjoy_capture *cap, const void *data, size_t len) {
+    if (cap->buflen + len > VJOY_CAPTURE_BUFFER) {
+        vjoy_capture_drain(cap);
+    }
+    if (len > VJOY_CAPTURE_BUFFER) {
+        // Never happens for frames, VJOY_FRAME_MAX events fit many times over
+        return;
+    }
+    memcpy(cap->buf + cap->buflen, data, len);
+    cap->buflen += len;
+    cap->offset += len;
+}
+
+int vjoy_capture_open(vjoy_dev *dev) {
+    if (!vjoy_capture_enabled) {
+        return 0;
+    }
+    char path[4096 + 32];
+    vjoy_capture *cap = calloc(1, sizeof(vjoy_capture));
+    if (cap == NULL) {
+        return -1;
+    }
+    // Never overwrite the capture of an earlier device that had this id
+    snprintf(path, sizeof(path), "%s/vjoy%i.vjcap", vjoy_capture_dir, dev->id);
+    cap->fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    for (int n=1; cap->fd < 0 && errno == EEXIST && n<VJOY_CAPTURE_SUFFIXES; n++) {
+        snprintf(path, sizeof(path), "%s/vjoy%i-%i.vjcap", vjoy_capture_dir, dev->id, n);
+        cap->fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    }
+    if (cap->fd < 0) {
+        vjoy_log(VJOY_LOG_ERROR, "Failed to open capture %s: %s", path, strerror(errno));
+        free(cap);
+        return -1;
+    }
+    pthread_mutex_init(&cap->lock, NULL);
+
+    vjoy_capture_header header;
+    memset(&header, 0, sizeof(vjoy_capture_header));
+    memcpy(header.magic, VJOY_CAPTURE_MAGIC, sizeof(VJOY_CAPTURE_MAGIC));
+    header.version  = VJOY_CAPTURE_VERSION;
+    header.infosize = sizeof(vjoy_info);
+    header.info     = dev->devinfo;
+    vjoy_capture_append(cap, &header, sizeof(vjoy_capture_header));
+    vjoy_capture_drain(cap);
+
+    vjoy_log(VJOY_LOG_INFO, "\tCapturing to %s", path);
+    dev->capture = cap;
+    return 0;
+}
+
+// Called from vjoy_dev_flush() with the events about to be written
+void vjoy_capture_frame_write(vjoy_dev *dev, const struct input_event *events, int count) {
+    vjoy_capture *cap = dev->capture;
+    if (count <= 0) {
+        return;
+    }
+    pthread_mutex_lock(&cap->lock);
+    if (cap->closed) {
+        pthread_mutex_unlock(&cap->lock);
+        return;
+    }
+    vjoy_capture_frame frame;
+    frame.time     = vjoy_stats_now() - vjoy_capture_epoch;
+    frame.count    = count;
+    frame.reserved = 0;
+    if (frame.time >= cap->nextindex) {
+        if (cap->indexcount == cap->indexsize) {
+            uint64_t            size  = cap->indexsize ? cap->indexsize * 2 : 1024;
+            vjoy_capture_index *index = realloc(cap->index, size * sizeof(vjoy_capture_index));
+            if (index != NULL) {
+                cap->index     = index;
+                cap->indexsize = size;
+            }
+        }
+        if (cap->indexcount < cap->indexsize) {
+            cap->index[cap->indexcount].time   = frame.time;
+            cap->index[cap->indexcount].offset = cap->offset;
+            cap->indexcount++;
+        }
+        cap->nextindex = frame.time - frame.time % VJOY_CAPTURE_INDEX_NS + VJOY_CAPTURE_INDEX_NS;
+    }
+    vjoy_capture_append(cap, &frame, sizeof(vjoy_capture_frame));
+    for (int i=0; i<count; i++) {
+        vjoy_packed_event rec = {events[i].type, events[i].code, events[i].value};
+        vjoy_capture_append(cap, &rec, sizeof(vjoy_packed_event));
+    }
+    cap->framecount++;
+    pthread_mutex_unlock(&cap->lock);
+}
+
+// Write out the index and fix up the header; safe to call from any thread
+void vjoy_capture_finish(vjoy_dev *dev) {
+    vjoy_capture *cap = dev->capture;
+    if (cap == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&cap->lock);
+    if (!cap->closed) {
+        uint64_t indexoffset = cap->offset;
+        for (uint64_t i=0; i<cap->indexcount; i++) {
+            vjoy_capture_append(cap, &cap->index[i], sizeof(vjoy_capture_index));
+        }
+        vjoy_capture_drain(cap);
+        vjoy_capture_header header;
+        if (pread(cap->fd, &header, sizeof(vjoy_capture_header), 0) == sizeof(vjoy_capture_header)) {
+            header.framecount  = cap->framecount;
+            header.indexoffset = indexoffset;
+            header.indexcount  = cap->indexcount;
+            if (pwrite(cap->fd, &header, sizeof(vjoy_capture_header), 0) != sizeof(vjoy_capture_header)) {
+                vjoy_log(VJOY_LOG_ERROR, "Failed to finish capture of device %i.", dev->id);
+            }
+        }
+        close(cap->fd);
+        free(cap->index);
+        cap->index  = NULL;
+        cap->closed = 1;
+        vjoy_log(VJOY_LOG_INFO, "Captured %llu frames from device %i.",
+                 (unsigned long long)cap->framecount, dev->id);
+    }
+    pthread_mutex_unlock(&cap->lock);
+}
+
+// Finish the capture and free it; the device must be off its reactor
+void vjoy_capture_close(vjoy_dev *dev) {
+    vjoy_capture *cap = dev->capture;
+    if (cap == NULL) {
+        return;
+    }
+    vjoy_capture_finish(dev);
+    pthread_mutex_destroy(&cap->lock);
+    free(cap);
+    dev->capture = NULL;
+}
+
+typedef struct _vjoy_replay_file {
+    const char          *path;
+    const char          *data;
+    size_t               size;
+    uint64_t             end;    // Where frames stop, the index or end of file
+    uint64_t             next;   // Offset of the next frame to play
+    vjoy_dev            *dev;
+    // State folded from the frames skipped by a seek, frames only carry changes
+    uint64_t             absset;
+    int32_t              abs[ABS_CNT];
+    unsigned char        keys[KEY_CNT];
+} vjoy_replay_file;
+
+// The next frame of a replay, or NULL at the end (or at a torn record)
+static const vjoy_capture_frame *vjoy_replay_peek(vjoy_replay_file *file) {
+    if (file->next + sizeof(vjoy_capture_frame) > file->end) {
+        return NULL;
+    }
+    const vjoy_capture_frame *frame = (const vjoy_capture_frame*)(file->data + file->next);
+    if (file->next + sizeof(vjoy_capture_frame) + frame->count * sizeof(vjoy_packed_event) > file->end) {
+        return NULL;
+    }
+    return frame;
+}
+
+// Skip one frame, remembering the axis and key states it leaves behind
+static void vjoy_replay_skip(vjoy_replay_file *file, const vjoy_capture_frame *frame) {
+    const vjoy_packed_event *recs = (const vjoy_packed_event*)(frame + 1);
+    for (uint32_t i=0; i<frame->count; i++) {
+        if (recs[i].type == EV_ABS && recs[i].code < ABS_CNT) {
+            file->abs[recs[i].code]  = recs[i].value;
+            file->absset            |= 1ULL << recs[i].code;
+        } else if (recs[i].type == EV_KEY && recs[i].code < KEY_CNT) {
+            file->keys[recs[i].code] = recs[i].value != 0;
+        }
+    }
+    file->next += sizeof(vjoy_capture_frame) + frame->count * sizeof(vjoy_packed_event);
+}
+
+/* Position a replay at the first frame at or after the given capture time.
+ * Every skipped frame is still folded into the state snapshot, so the index
+ * only bounds the part scanned by time.
+ */
+static void vjoy_replay_seek(vjoy_replay_file *file, uint64_t time) {
+    const vjoy_capture_header *header = (const vjoy_capture_header*)file->data;
+    const vjoy_capture_frame  *frame;
+    if (header->indexoffset != 0) {
+        // Last index entry not after the target, everything before it is skipped
+        const vjoy_capture_index *index = (const vjoy_capture_index*)(file->data + header->indexoffset);
+        uint64_t lo = 0, hi = header->indexcount;
+        while (lo < hi) {
+            uint64_t mid = (lo + hi) / 2;
+            if (index[mid].time <= time) lo = mid + 1; else hi = mid;
+        }
+        if (lo > 0) {
+            while (file->next < index[lo - 1].offset && (frame = vjoy_replay_peek(file)) != NULL) {
+                vjoy_replay_skip(file, frame);
+            }
+        }
+    }
+    while ((frame = vjoy_replay_peek(file)) != NULL && frame->time < time) {
+        vjoy_replay_skip(file, frame);
+    }
+}
+
+static int vjoy_replay_open(vjoy_replay_file *file, int id) {
+    int fd = open(file->path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        vjoy_log(VJOY_LOG_ERROR, "Failed to open %s: %s", file->path, strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(vjoy_capture_header)) {
+        vjoy_log(VJOY_LOG_ERROR, "%s is not a capture.", file->path);
+        close(fd);
+        return -1;
+    }
+    file->size = st.st_size;
+    file->data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (file->data == MAP_FAILED) {
+        vjoy_log(VJOY_LOG_ERROR, "Failed to map %s: %s", file->path, strerror(errno));
+        file->data = NULL;
+        return -1;
+    }
+    madvise((void*)file->data, file->size, MADV_SEQUENTIAL);
+
+    const vjoy_capture_header *header = (const vjoy_capture_header*)file->data;
+    if (memcmp(header->magic, VJOY_CAPTURE_MAGIC, sizeof(VJOY_CAPTURE_MAGIC)) != 0 ||
+        header->version != VJOY_CAPTURE_VERSION || header->infosize != sizeof(vjoy_info)) {
+        vjoy_log(VJOY_LOG_ERROR, "%s is not a capture from this version of vjoy.", file->path);
+        return -1;
+    }
+    file->next = sizeof(vjoy_capture_header);
+    file->end  = file->size;
+    if (header->indexoffset != 0) {
+        if (header->indexoffset > file->size ||
+            header->indexcount > (file->size - header->indexoffset) / sizeof(vjoy_capture_index)) {
+            vjoy_log(VJOY_LOG_ERROR, "%s has a damaged index.", file->path);
+            return -1;
+        }
+        file->end = header->indexoffset;
+    } else {
+        vjoy_log(VJOY_LOG_WARN, "%s was not closed cleanly, replaying what is there.", file->path);
+    }
+
+    // Recreate the device from the captured capabilities
+    vjoy_log(VJOY_LOG_INFO, "Creating device for %s:", file->path);
+    file->dev = calloc(1, sizeof(vjoy_dev));
+    if (file->dev == NULL) {
+        return -1;
+    }
+    vjoy_dev *dev = file->dev;
+    dev->id      = id;
+    dev->uifd    = -1;
+    dev->tickfd  = -1;
+    dev->devinfo = header->info;
+    // Nobody would answer force feedback uploads, and uinput makes games wait for that
+    dev->devinfo.feedbackcount = 0;
+    dev->devinfo.maxeffects    = 0;
+    strncpy(dev->uidev.name, dev->devinfo.name, UINPUT_MAX_NAME_SIZE);
+    dev->backend = vjoy_backend_current();
+    if (dev->backend->open(dev) < 0 || dev->backend->create(dev) < 0) {
+        return -1;
+    }
+    vjoy_log(VJOY_LOG_INFO, "Device created.");
+    return 0;
+}
+
+// Undo vjoy_replay_open(), however far it got
+static void vjoy_replay_close(vjoy_replay_file *file) {
+    if (file->dev != NULL) {
+        if (file->dev->backend != NULL) {
+            file->dev->backend->close(file->dev);
+        }
+        free(file->dev);
+        file->dev = NULL;
+    }
+    if (file->data != NULL) {
+        munmap((void*)file->data, file->size);
+        file->data = NULL;
+    }
+}
+
+static void vjoy_replay_write(vjoy_dev *dev, const vjoy_capture_frame *frame) {
+    const vjoy_packed_event *recs = (const vjoy_packed_event*)(frame + 1);
+    struct timeval           now;
+    gettimeofday(&now, NULL);
+    for (uint32_t done=0; done<frame->count; ) {
+        int n = 0;
+        for (; n<VJOY_FRAME_MAX && done+n<frame->count; n++) {
+            dev->frame[n].time  = now;
+            dev->frame[n].type  = recs[done+n].type;
+            dev->frame[n].code  = recs[done+n].code;
+            dev->frame[n].value = recs[done+n].value;
+        }
+        if (dev->backend->write(dev, dev->frame, n * sizeof(struct input_event)) < 0) {
+            static vjoy_log_limit writeerr;
+            vjoy_log_limited(&writeerr, VJOY_LOG_ERROR, "Error writing events: %s", strerror(errno));
+        }
+        done += n;
+    }
+}
+
+// Send the staged events of a replayed device, ended by a SYN_REPORT
+static void vjoy_replay_send(vjoy_dev *dev, int count) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    dev->frame[count].type  = EV_SYN;
+    dev->frame[count].code  = SYN_REPORT;
+    dev->frame[count].value = 0;
+    for (int i=0; i<=count; i++) {
+        dev->frame[i].time = now;
+    }
+    if (dev->backend->write(dev, dev->frame, (count + 1) * sizeof(struct input_event)) < 0) {
+        static vjoy_log_limit writeerr;
+        vjoy_log_limited(&writeerr, VJOY_LOG_ERROR, "Error writing events: %s", strerror(errno));
+    }
+}
+
+// Bring a device seeked into its capture to the state the skipped frames left
+static void vjoy_replay_snapshot(vjoy_replay_file *file) {
+    vjoy_dev *dev = file->dev;
+    int       n   = 0;
+    for (int code=0; code<ABS_CNT; code++) {
+        if (file->absset & (1ULL << code)) {
+            dev->frame[n].type  = EV_ABS;
+            dev->frame[n].code  = code;
+            dev->frame[n].value = file->abs[code];
+            if (++n == VJOY_FRAME_MAX - 1) {
+                vjoy_replay_send(dev, n);
+                n = 0;
+            }
+        }
+    }
+    // Devices are created with every key released
+    for (int code=0; code<KEY_CNT; code++) {
+        if (file->keys[code]) {
+            dev->frame[n].type  = EV_KEY;
+            dev->frame[n].code  = code;
+            dev->frame[n].value = 1;
+            if (++n == VJOY_FRAME_MAX - 1) {
+                vjoy_replay_send(dev, n);
+                n = 0;
+            }
+        }
+    }
+    if (n > 0) {
+        vjoy_replay_send(dev, n);
+    }
+}
+
+/* Play captures back with their original timing, starting offset seconds
+ * in.  Several files (one per captured device) are merged on their shared
+ * capture clock.  Runs until every file is exhausted.
+ */
+int vjoy_replay(char **paths, int count, double offset) {
+    vjoy_replay_file *files = calloc(count, sizeof(vjoy_replay_file));
+    if (files == NULL) {
+        return -1;
+    }
+    uint64_t seek  = offset > 0 ? offset * 1e9 : 0;
+    uint64_t first = UINT64_MAX;
+    for (int i=0; i<count; i++) {
+        files[i].path = paths[i];
+        if (vjoy_replay_open(&files[i], i) < 0) {
+            for (int j=0; j<=i; j++) {
+                vjoy_replay_close(&files[j]);
+            }
+            free(files);
+            return -1;
+        }
+        if (seek > 0) {
+            vjoy_replay_seek(&files[i], seek);
+            vjoy_replay_snapshot(&files[i]);
+        }
+        const vjoy_capture_frame *frame = vjoy_replay_peek(&files[i]);
+        if (frame != NULL && frame->time < first) {
+            first = frame->time;
+        }
+    }
+
+    // Deadlines are absolute, so write time never accumulates as drift
+    prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0);
+    unsigned long long start  = vjoy_stats_now();
+    unsigned long      frames = 0;
+    while (1) {
+        vjoy_replay_file         *file = NULL;
+        const vjoy_capture_frame *next = NULL;
+        for (int i=0; i<count; i++) {
+            const vjoy_capture_frame *frame = vjoy_replay_peek(&files[i]);
+            if (frame != NULL && (next == NULL || frame->time < next->time)) {
+                file = &files[i];
+                next = frame;
+            }
+        }
+        if (next == NULL) {
+            break;
+        }
+        unsigned long long deadline = start + (next->time - first);
+        struct timespec    ts       = {deadline / 1000000000ULL, deadline % 1000000000ULL};
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+        vjoy_replay_write(file->dev, next);
+        file->next += sizeof(vjoy_capture_frame) + next->count * sizeof(vjoy_packed_event);
+        frames++;
+    }
+    vjoy_log(VJOY_LOG_INFO, "Replayed %lu frames in %.3f s.", frames, (vjoy_stats_now() - start) / 1e9);
+
+    for (int i=0; i<count; i++) {
+        vjoy_replay_close(&files[i]);
+    }
+    free(files);
+    return 0;
+}
@@ -0,0 +1,52 @@
+#ifndef _VJOY_CAPTURE_H
+#define _VJOY_CAPTURE_H
+
+#include <stdint.h>
+
+#define VJOY_CAPTURE_MAGIC      "VJOYCAP"
+#define VJOY_CAPTURE_VERSION    2
+#define VJOY_CAPTURE_INDEX_NS   1000000000ULL // Capture time between index entries
+#define VJOY_CAPTURE_BUFFER     65536         // Bytes buffered before a write()
+#define VJOY_CAPTURE_SUFFIXES   10000         // vjoy<id>-<n>.vjcap tried when vjoy<id>.vjcap exists
+
+struct _vjoy_dev;
+
+/* Capture file layout, native endian, every record 8 byte aligned:
+ *
+ *   vjoy_capture_header
+ *   { vjoy_capture_frame, vjoy_packed_event[count] } ...
+ *   vjoy_capture_index[indexcount]  (at indexoffset, written on close)
+ *
+ * A capture cut short keeps indexoffset 0 and is replayed by scanning.
+ */
+typedef struct _vjoy_capture_header {
+    char      magic[8];     // VJOY_CAPTURE_MAGIC
+    uint32_t  version;      // VJOY_CAPTURE_VERSION
+    uint32_t  infosize;     // sizeof(vjoy_info) of the writer
+    uint64_t  framecount;   // Filled in on close
+    uint64_t  indexoffset;  // Filled in on close, 0 until then
+    uint64_t  indexcount;
+    vjoy_info info;         // Capabilities of the captured device
+} vjoy_capture_header;
+
+typedef struct _vjoy_capture_frame {
+    uint64_t time;   // Nanoseconds since capture started, shared by every device
+    uint32_t count;  // vjoy_packed_event records that follow
+    uint32_t reserved;
+} vjoy_capture_frame;
+
+typedef struct _vjoy_capture_index {
+    uint64_t time;   // Of the first frame at or after each VJOY_CAPTURE_INDEX_NS
+    uint64_t offset; // File offset of that frame's vjoy_capture_frame
+} vjoy_capture_index;
+
+typedef struct _vjoy_capture vjoy_capture;
+
+int  vjoy_capture_start(const char *dir);
+int  vjoy_capture_open(struct _vjoy_dev *dev);
+void vjoy_capture_frame_write(struct _vjoy_dev *dev, const struct input_event *events, int count);
+void vjoy_capture_finish(struct _vjoy_dev *dev);
+void vjoy_capture_close(struct _vjoy_dev *dev);
+int  vjoy_replay(char **paths, int count, double offset);
+
+#endif /* _VJOY_CAPTURE_H */
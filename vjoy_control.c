@@ -0,0 +1,233 @@
+#include "vjoy.h"
+#include "vjoy_control.h"
+#include "vjoy_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/* Control socket.  Clients send one command per line and get back any
+ * output lines followed by "ok [result]" or "error: reason":
+ *
+ *   load MODULE   create MODULE's devices, ok lists their ids
+ *   unload ID     remove the module running device ID
+ *   list          id, group leader, module and name of every device
+ *   stats         the stats socket's report
+ *   pool          module, ready/target and name of every pool profile
+ */
+
+typedef struct _vjoy_control_client {
+    int  fd;
+    int  len;
+    char line[VJOY_CONTROL_LINE];
+} vjoy_control_client;
+
+static pthread_t           vjoy_control_thread;
+static int                 vjoy_control_listenfd = -1;
+static char                vjoy_control_path[sizeof(((struct sockaddr_un*)0)->sun_path)];
+static vjoy_control_client vjoy_control_clients[VJOY_CONTROL_CLIENTS];
+
+// Run one command, returning whether the pool may need refilling afterwards
+static int vjoy_control_command(char *line, FILE *out) {
+    char *cmd = strtok(line, " \t\r");
+    char *arg = strtok(NULL, " \t\r");
+    if (cmd == NULL) {
+        fprintf(out, "error: empty command\n");
+    } else if (strcmp(cmd, "load") == 0 && arg != NULL) {
+        int id = vjoy_load_module(arg);
+        if (id < 0) {
+            fprintf(out, "error: failed to load %s\n", arg);
+            return 0;
+        }
+        vjoy_devices_lock();
+        vjoy_dev *dev = vjoy_get_device(id);
+        fprintf(out, "ok");
+        for (int i=0; dev != NULL && i<dev->membercount; i++) {
+            fprintf(out, " %i", dev->members[i]->id);
+        }
+        fprintf(out, "\n");
+        vjoy_devices_unlock();
+        return 1;
+    } else if (strcmp(cmd, "unload") == 0 && arg != NULL) {
+        char *end;
+        errno   = 0;
+        long id = strtol(arg, &end, 10);
+        if (end == arg || *end != '\0' || errno != 0 || id < 0 || id >= VJOY_MAX_DEVICES) {
+            fprintf(out, "error: bad id %s\n", arg);
+        } else if (vjoy_unload_device(id) < 0) {
+            fprintf(out, "error: no device %s\n", arg);
+        } else {
+            fprintf(out, "ok\n");
+        }
+    } else if (strcmp(cmd, "list") == 0) {
+        vjoy_devices_lock();
+        for (int id=0; id<VJOY_MAX_DEVICES; id++) {
+            vjoy_dev *dev = vjoy_get_device(id);
+            if (dev != NULL) {
+                fprintf(out, "%i\t%i\t%s\t%s\n", dev->id, dev->leader->id, dev->modname, dev->devinfo.name);
+            }
+        }
+        vjoy_devices_unlock();
+        fprintf(out, "ok\n");
+    } else if (strcmp(cmd, "stats") == 0) {
+        vjoy_devices_lock();
+        vjoy_stats_report(out);
+        vjoy_devices_unlock();
+        fprintf(out, "ok\n");
+    } else if (strcmp(cmd, "pool") == 0) {
+        vjoy_pool_report(out);
+        fprintf(out, "ok\n");
+    } else {
+        fprintf(out, "error: unknown command, expected load MODULE, unload ID, list, stats or pool\n");
+    }
+    return 0;
+}
+
+static void vjoy_control_reply(int fd, char *line) {
+    char   *text   = NULL;
+    size_t  len    = 0;
+    int     refill = 0;
+    FILE   *out    = open_memstream(&text, &len);
+    if (out == NULL) {
+        return;
+    }
+    refill = vjoy_control_command(line, out);
+    fclose(out);
+    for (size_t done=0; done<len; ) {
+        ssize_t s = send(fd, text + done, len - done, MSG_NOSIGNAL);
+        if (s < 0 && errno == EINTR) continue;
+        if (s <= 0) break;
+        done += s;
+    }
+    free(text);
+    // After replying, so a load never waits on replacing the device it took
+    if (refill) {
+        vjoy_pool_refill();
+    }
+}
+
+// Run every complete line a client has sent; returns -1 once it is gone
+static int vjoy_control_read(vjoy_control_client *client) {
+    ssize_t s = recv(client->fd, client->line + client->len,
+                     sizeof(client->line) - 1 - client->len, 0);
+    if (s < 0 && (errno == EINTR || errno == EAGAIN)) {
+        return 0;
+    }
+    if (s <= 0) {
+        return -1;
+    }
+    client->len += s;
+    char *start = client->line;
+    char *end;
+    while ((end = memchr(start, '\n', client->len - (start - client->line))) != NULL) {
+        *end = '\0';
+        vjoy_control_reply(client->fd, start);
+        start = end + 1;
+    }
+    client->len -= start - client->line;
+    memmove(client->line, start, client->len);
+    if (client->len >= (int)sizeof(client->line) - 1) {
+        vjoy_log(VJOY_LOG_WARN, "Dropping control client, line too long.");
+        return -1;
+    }
+    return 0;
+}
+
+static void *vjoy_control_loop(void *arg) {
+    struct pollfd fds[VJOY_CONTROL_CLIENTS + 1];
+    for (int i=0; i<VJOY_CONTROL_CLIENTS; i++) {
+        vjoy_control_clients[i].fd = -1;
+    }
+    while (1) {
+        fds[0].fd     = vjoy_control_listenfd;
+        fds[0].events = POLLIN;
+        for (int i=0; i<VJOY_CONTROL_CLIENTS; i++) {
+            fds[i + 1].fd     = vjoy_control_clients[i].fd;
+            fds[i + 1].events = POLLIN;
+        }
+        if (poll(fds, VJOY_CONTROL_CLIENTS + 1, -1) < 0) {
+            continue;
+        }
+        for (int i=0; i<VJOY_CONTROL_CLIENTS; i++) {
+            vjoy_control_client *client = &vjoy_control_clients[i];
+            if (client->fd >= 0 && (fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) &&
+                vjoy_control_read(client) < 0) {
+                close(client->fd);
+                client->fd = -1;
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            int fd = accept4(vjoy_control_listenfd, NULL, NULL, SOCK_CLOEXEC);
+            if (fd < 0) {
+                continue;
+            }
+            vjoy_control_client *slot = NULL;
+            for (int i=0; i<VJOY_CONTROL_CLIENTS && slot == NULL; i++) {
+                if (vjoy_control_clients[i].fd < 0) {
+                    slot = &vjoy_control_clients[i];
+                }
+            }
+            if (slot == NULL) {
+                static const char busy[] = "error: too many control clients\n";
+                send(fd, busy, sizeof(busy) - 1, MSG_NOSIGNAL);
+                close(fd);
+                continue;
+            }
+            // A stalled reader must not hold up everyone else for long
+            struct timeval timeout = {1, 0};
+            setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+            slot->fd  = fd;
+            slot->len = 0;
+        }
+    }
+    return NULL;
+}
+
+static void vjoy_control_unlink() {
+    unlink(vjoy_control_path);
+}
+
+int vjoy_control_start(const char *path) {
+    // Control socket, $XDG_RUNTIME_DIR/vjoy.control unless told otherwise
+    if (path == NULL) {
+        const char *rundir = getenv("XDG_RUNTIME_DIR");
+        if (rundir != NULL) {
+            snprintf(vjoy_control_path, sizeof(vjoy_control_path), "%s/vjoy.control", rundir);
+        } else {
+            snprintf(vjoy_control_path, sizeof(vjoy_control_path), "/tmp/vjoy-%i.control", (int)getuid());
+        }
+    } else if (path[0] != '\0') {
+        snprintf(vjoy_control_path, sizeof(vjoy_control_path), "%s", path);
+    } else {
+        return 0;
+    }
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(struct sockaddr_un));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, vjoy_control_path, sizeof(addr.sun_path) - 1);
+    unlink(vjoy_control_path);
+    vjoy_control_listenfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    // Loading modules runs code, so only the owner may connect
+    if (vjoy_control_listenfd < 0 ||
+        bind(vjoy_control_listenfd, (struct sockaddr*)&addr, sizeof(struct sockaddr_un)) < 0 ||
+        chmod(vjoy_control_path, 0600) < 0 ||
+        listen(vjoy_control_listenfd, 4) < 0) {
+        vjoy_log(VJOY_LOG_WARN, "Control socket %s unavailable: %s", vjoy_control_path, strerror(errno));
+        if (vjoy_control_listenfd >= 0) close(vjoy_control_listenfd);
+        vjoy_control_listenfd = -1;
+        return -1;
+    }
+    vjoy_log(VJOY_LOG_INFO, "Accepting commands on %s", vjoy_control_path);
+    atexit(vjoy_control_unlink);
+
+    if (pthread_create(&vjoy_control_thread, NULL, vjoy_control_loop, NULL) != 0) {
+        vjoy_log(VJOY_LOG_ERROR, "Failed to start control thread.");
+        return -1;
+    }
+    return 0;
+}
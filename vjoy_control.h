@@ -0,0 +1,9 @@
+#ifndef _VJOY_CONTROL_H
+#define _VJOY_CONTROL_H
+
+#define VJOY_CONTROL_CLIENTS 8   // Control connections served at once
+#define VJOY_CONTROL_LINE    512 // Longest command line
+
+int vjoy_control_start(const char *path);
+
+#endif /* _VJOY_CONTROL_H */
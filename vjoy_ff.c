@@ -0,0 +1,256 @@
+#include "vjoy.h"
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+/* Native force feedback playback.  Mirrors what the kernel's ff-memless
+ * does for real hardware: uploads land in per-id slots, EV_FF events start
+ * and stop them, and every tick the playing effects are evaluated (replay
+ * timing, envelopes, waveforms, ramps, conditions) and mixed into a single
+ * force vector plus rumble magnitudes that modules can read back.
+ */
+
+#define VJOY_FF_PI        3.14159265358979f
+#define VJOY_FF_MAX_FORCE 32767.0f
+#define VJOY_FF_MAX_MOTOR 65535.0f
+
+long long vjoy_ff_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+void vjoy_ff_init(vjoy_ff_state *ff, int slotcount) {
+    memset(ff, 0, sizeof(vjoy_ff_state));
+    if (slotcount < 0) slotcount = 0;
+    if (slotcount > FF_MAX_EFFECTS) slotcount = FF_MAX_EFFECTS;
+    ff->slotcount = slotcount;
+    ff->gain      = 0xffff;
+    ff->lasttick  = vjoy_ff_now();
+}
+
+int vjoy_ff_upload(vjoy_ff_state *ff, struct ff_effect *effect) {
+    if (effect->id < 0 || effect->id >= ff->slotcount) {
+        return -1;
+    }
+    // Updating a playing effect keeps its playback position, like ff-core
+    vjoy_ff_slot *slot = &ff->slots[effect->id];
+    slot->effect   = *effect;
+    slot->uploaded = 1;
+    return 0;
+}
+
+void vjoy_ff_erase(vjoy_ff_state *ff, int id) {
+    if (id >= 0 && id < ff->slotcount) {
+        memset(&ff->slots[id], 0, sizeof(vjoy_ff_slot));
+    }
+}
+
+/* Queue an upload (or erasure) for the module once the kernel has its
+ * answer, so the game never waits on Python.  Returns -1 and drops the
+ * notice if the module has fallen a whole ring behind.
+ */
+int vjoy_ff_notify(vjoy_ff_state *ff, int erase, const struct ff_effect *effect) {
+    unsigned head = ff->head;
+    if (head - __atomic_load_n(&ff->tail, __ATOMIC_ACQUIRE) >= VJOY_FF_NOTICES) {
+        return -1;
+    }
+    vjoy_ff_notice *notice = &ff->notices[head & (VJOY_FF_NOTICES - 1)];
+    notice->erase  = erase;
+    notice->effect = *effect;
+    __atomic_store_n(&ff->head, head + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+// Take the oldest queued notice, 0 if there is none
+int vjoy_ff_next_notice(vjoy_ff_state *ff, vjoy_ff_notice *notice) {
+    unsigned tail = ff->tail;
+    if (tail == __atomic_load_n(&ff->head, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+    *notice = ff->notices[tail & (VJOY_FF_NOTICES - 1)];
+    __atomic_store_n(&ff->tail, tail + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+void vjoy_ff_event(vjoy_ff_state *ff, int code, int value, long long now) {
+    if (code == FF_GAIN) {
+        ff->gain = value & 0xffff;
+    } else if (code == FF_AUTOCENTER) {
+        ff->autocenter = value & 0xffff;
+    } else if (code >= 0 && code < ff->slotcount && ff->slots[code].uploaded) {
+        ff->slots[code].plays   = value > 0 ? value : 0;
+        ff->slots[code].started = now;
+    }
+}
+
+/* Milliseconds into the slot's current repetition, or -1 while it is idle or
+ * still waiting out its replay delay.  Finished repetitions are retired here.
+ */
+static long long vjoy_ff_elapsed(vjoy_ff_slot *slot, long long now) {
+    if (!slot->uploaded || slot->plays <= 0) {
+        return -1;
+    }
+    long long delay  = slot->effect.replay.delay;
+    long long length = slot->effect.replay.length;
+    if (length > 0) {
+        long long cycle = delay + length;
+        long long done  = (now - slot->started) / cycle;
+        if (done > 0) {
+            slot->plays   -= done < slot->plays ? done : slot->plays;
+            slot->started += done * cycle;
+            if (slot->plays <= 0) {
+                return -1;
+            }
+        }
+    }
+    long long t = now - slot->started - delay;
+    return t >= 0 ? t : -1;
+}
+
+static float vjoy_ff_envelope(const struct ff_envelope *env, float level,
+                              long long t, int length) {
+    float mag  = fabsf(level);
+    float sign = level < 0 ? -1.0f : 1.0f;
+    if (env->attack_length > 0 && t < env->attack_length) {
+        mag = env->attack_level + (mag - env->attack_level) * t / env->attack_length;
+    } else if (env->fade_length > 0 && length > 0 && t > length - env->fade_length) {
+        long long left = length - t;
+        mag = env->fade_level + (mag - env->fade_level) * left / env->fade_length;
+    }
+    return sign * mag;
+}
+
+static float vjoy_ff_waveform(const struct ff_periodic_effect *periodic, long long t) {
+    int   period = periodic->period > 0 ? periodic->period : 1;
+    float frac   = (float)((t + (long long)periodic->phase * period / 0x10000) % period) / period;
+    switch (periodic->waveform) {
+        case FF_SQUARE:   return frac < 0.5f ? 1.0f : -1.0f;
+        case FF_TRIANGLE: return 1.0f - 4.0f * fabsf(frac - 0.5f);
+        case FF_SINE:     return sinf(2.0f * VJOY_FF_PI * frac);
+        case FF_SAW_UP:   return 2.0f * frac - 1.0f;
+        case FF_SAW_DOWN: return 1.0f - 2.0f * frac;
+        default:          return 0.0f; // FF_CUSTOM data is never copied from the game
+    }
+}
+
+// Force a condition produces for an axis position, velocity or acceleration
+static float vjoy_ff_condition(const struct ff_condition_effect *cond, float x) {
+    float d    = x - cond->center;
+    float half = cond->deadband / 2.0f;
+    float f, sat;
+    if (fabsf(d) <= half) {
+        return 0.0f;
+    }
+    if (d > 0) {
+        f   = -(d - half) * cond->right_coeff / VJOY_FF_MAX_FORCE;
+        sat = cond->right_saturation / 2.0f;
+    } else {
+        f   = -(d + half) * cond->left_coeff / VJOY_FF_MAX_FORCE;
+        sat = cond->left_saturation / 2.0f;
+    }
+    if (sat > 0) {
+        f = f > sat ? sat : (f < -sat ? -sat : f);
+    }
+    return f;
+}
+
+static int vjoy_ff_clamp(float v, float lo, float hi) {
+    return (int)(v > hi ? hi : (v < lo ? lo : v));
+}
+
+void vjoy_ff_evaluate(vjoy_ff_state *ff, long long now, int posx, int posy) {
+    float level[FF_MAX_EFFECTS], dirx[FF_MAX_EFFECTS], diry[FF_MAX_EFFECTS];
+    float condx[FF_MAX_EFFECTS], condy[FF_MAX_EFFECTS];
+    float strong[FF_MAX_EFFECTS], weak[FF_MAX_EFFECTS];
+    int   n = ff->slotcount;
+
+    // Axis motion in full-range-per-second units, for dampers and inertia
+    float pos[2] = {posx, posy}, vel[2], acc[2];
+    float dt     = now > ff->lasttick ? (float)(now - ff->lasttick) : 1.0f;
+    for (int a=0; a<2; a++) {
+        vel[a] = (pos[a] - ff->lastpos[a]) * 500.0f / dt;
+        acc[a] = (vel[a] - ff->lastvel[a]) * 500.0f / dt;
+        ff->lastpos[a] = pos[a];
+        ff->lastvel[a] = vel[a];
+    }
+    ff->lasttick = now;
+
+    // Pass one: per slot magnitude, direction and condition contributions
+    for (int i=0; i<n; i++) {
+        vjoy_ff_slot     *slot   = &ff->slots[i];
+        struct ff_effect *effect = &slot->effect;
+        long long         t      = vjoy_ff_elapsed(slot, now);
+        float             angle  = effect->direction * 2.0f * VJOY_FF_PI / 0x10000;
+        level[i] = condx[i] = condy[i] = strong[i] = weak[i] = 0.0f;
+        dirx[i]  = sinf(angle);
+        diry[i]  = -cosf(angle);
+        if (t < 0) {
+            continue;
+        }
+        int length = effect->replay.length;
+        switch (effect->type) {
+            case FF_CONSTANT:
+                level[i] = vjoy_ff_envelope(&effect->u.constant.envelope,
+                                            effect->u.constant.level, t, length);
+                break;
+            case FF_RAMP: {
+                float span = length > 0 ? (float)t / length : 0.0f;
+                float ramp = effect->u.ramp.start_level +
+                             (effect->u.ramp.end_level - effect->u.ramp.start_level) * span;
+                level[i] = vjoy_ff_envelope(&effect->u.ramp.envelope, ramp, t, length);
+                break;
+            }
+            case FF_PERIODIC: {
+                float mag = vjoy_ff_envelope(&effect->u.periodic.envelope,
+                                             effect->u.periodic.magnitude, t, length);
+                level[i] = effect->u.periodic.offset + mag * vjoy_ff_waveform(&effect->u.periodic, t);
+                break;
+            }
+            case FF_RUMBLE:
+                strong[i] = effect->u.rumble.strong_magnitude;
+                weak[i]   = effect->u.rumble.weak_magnitude;
+                break;
+            case FF_SPRING:
+                condx[i] = vjoy_ff_condition(&effect->u.condition[0], pos[0]);
+                condy[i] = vjoy_ff_condition(&effect->u.condition[1], pos[1]);
+                break;
+            case FF_DAMPER:
+                condx[i] = vjoy_ff_condition(&effect->u.condition[0], vel[0]);
+                condy[i] = vjoy_ff_condition(&effect->u.condition[1], vel[1]);
+                break;
+            case FF_INERTIA:
+                condx[i] = vjoy_ff_condition(&effect->u.condition[0], acc[0]);
+                condy[i] = vjoy_ff_condition(&effect->u.condition[1], acc[1]);
+                break;
+            case FF_FRICTION:
+                // Constant drag opposing the direction of motion
+                condx[i] = vjoy_ff_condition(&effect->u.condition[0], vel[0] > 0 ? VJOY_FF_MAX_FORCE :
+                                             (vel[0] < 0 ? -VJOY_FF_MAX_FORCE : 0));
+                condy[i] = vjoy_ff_condition(&effect->u.condition[1], vel[1] > 0 ? VJOY_FF_MAX_FORCE :
+                                             (vel[1] < 0 ? -VJOY_FF_MAX_FORCE : 0));
+                break;
+            default:
+                break;
+        }
+    }
+
+    // Pass two: straight-line mixing over every slot
+    float fx = 0.0f, fy = 0.0f, ms = 0.0f, mw = 0.0f;
+    for (int i=0; i<n; i++) {
+        fx += level[i] * dirx[i] + condx[i];
+        fy += level[i] * diry[i] + condy[i];
+        ms += strong[i];
+        mw += weak[i];
+    }
+    if (ff->autocenter > 0) {
+        fx -= pos[0] * ff->autocenter / VJOY_FF_MAX_MOTOR;
+        fy -= pos[1] * ff->autocenter / VJOY_FF_MAX_MOTOR;
+    }
+
+    float gain = ff->gain / VJOY_FF_MAX_MOTOR;
+    ff->output.force[0] = vjoy_ff_clamp(fx * gain, -VJOY_FF_MAX_FORCE, VJOY_FF_MAX_FORCE);
+    ff->output.force[1] = vjoy_ff_clamp(fy * gain, -VJOY_FF_MAX_FORCE, VJOY_FF_MAX_FORCE);
+    ff->output.strong   = vjoy_ff_clamp(ms * gain, 0.0f, VJOY_FF_MAX_MOTOR);
+    ff->output.weak     = vjoy_ff_clamp(mw * gain, 0.0f, VJOY_FF_MAX_MOTOR);
+}
@@ -0,0 +1,52 @@
+#ifndef _VJOY_FF_H
+#define _VJOY_FF_H
+
+#include <linux/input.h>
+
+// Pre-mixed output of every playing effect, recomputed each tick
+typedef struct _vjoy_ff_output {
+    int force[2]; // Directional force along X and Y, -32767..32767
+    int strong;   // Rumble motors, 0..65535
+    int weak;
+} vjoy_ff_output;
+
+typedef struct _vjoy_ff_slot {
+    struct ff_effect effect;
+    int              uploaded;
+    int              plays;    // Remaining repetitions, 0 when stopped
+    long long        started;  // When the current repetition was started (ms)
+} vjoy_ff_slot;
+
+#define VJOY_FF_NOTICES 64 // Uploads/erasures queued for the module, a power of two
+
+// An upload or erasure already answered to the kernel, for the module to see
+typedef struct _vjoy_ff_notice {
+    int              erase;  // effect.id was erased, the rest is unused
+    struct ff_effect effect;
+} vjoy_ff_notice;
+
+typedef struct _vjoy_ff_state {
+    int            slotcount;                 // Effect ids handed out by the kernel
+    vjoy_ff_slot   slots[FF_MAX_EFFECTS];
+    int            gain;                      // FF_GAIN, 0..0xffff
+    int            autocenter;                // FF_AUTOCENTER, 0..0xffff
+    int            lastpos[2];                // Axis positions seen on the last tick
+    int            lastvel[2];
+    long long      lasttick;
+    vjoy_ff_output output;
+    // Single producer, single consumer ring of notices, free running indices
+    vjoy_ff_notice notices[VJOY_FF_NOTICES];
+    unsigned       head;                      // Written by the uinput side only
+    unsigned       tail;                      // Written by the module side only
+} vjoy_ff_state;
+
+long long vjoy_ff_now();
+void      vjoy_ff_init(vjoy_ff_state *ff, int slotcount);
+int       vjoy_ff_upload(vjoy_ff_state *ff, struct ff_effect *effect);
+void      vjoy_ff_erase(vjoy_ff_state *ff, int id);
+int       vjoy_ff_notify(vjoy_ff_state *ff, int erase, const struct ff_effect *effect);
+int       vjoy_ff_next_notice(vjoy_ff_state *ff, vjoy_ff_notice *notice);
+void      vjoy_ff_event(vjoy_ff_state *ff, int code, int value, long long now);
+void      vjoy_ff_evaluate(vjoy_ff_state *ff, long long now, int posx, int posy);
+
+#endif /* _VJOY_FF_H */
@@ -0,0 +1,179 @@
+#include "vjoy.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <time.h>
+
+/* Logging that never blocks the reactors.  Every thread formats into a ring
+ * of its own that only it writes to; a background thread drains all rings to
+ * stdout/stderr.  When a ring is full messages are dropped and counted
+ * rather than waiting on a slow pipe.
+ */
+
+typedef struct _vjoy_log_entry {
+    vjoy_log_level level;
+    char           text[VJOY_LOG_LINE];
+} vjoy_log_entry;
+
+typedef struct _vjoy_log_ring {
+    unsigned               head;    // Next entry to write, owned by the producer
+    unsigned               tail;    // Next entry to print, owned by the flusher
+    unsigned long          dropped; // Messages lost to a full ring
+    int                    idle;    // Its thread exited, the next new thread takes it over
+    struct _vjoy_log_ring *next;
+    vjoy_log_entry         entries[VJOY_LOG_RING];
+} vjoy_log_ring;
+
+vjoy_log_level                 vjoy_log_threshold = VJOY_LOG_INFO;
+static __thread vjoy_log_ring *vjoy_log_local     = NULL;
+static vjoy_log_ring          *vjoy_log_rings     = NULL;
+static pthread_key_t           vjoy_log_key;
+static pthread_once_t          vjoy_log_once      = PTHREAD_ONCE_INIT;
+static pthread_mutex_t         vjoy_log_lock      = PTHREAD_MUTEX_INITIALIZER; // Between flushers only
+static pthread_t               vjoy_log_thread;
+static int                     vjoy_log_running   = 0;
+
+static const char *vjoy_log_prefix[] = {"error: ", "warning: ", "", ""};
+
+static void vjoy_log_print(vjoy_log_level level, const char *text) {
+    FILE *out = level <= VJOY_LOG_WARN ? stderr : stdout;
+    if (out == stderr) {
+        fflush(stdout); // Keep both streams in order when they share a terminal
+    }
+    fprintf(out, "%s%s\n", vjoy_log_prefix[level], text);
+}
+
+// Rings outlive their threads so queued lines still get printed, then are reused
+static void vjoy_log_ring_release(void *ring) {
+    __atomic_store_n(&((vjoy_log_ring*)ring)->idle, 1, __ATOMIC_RELEASE);
+}
+
+static void vjoy_log_key_create() {
+    pthread_key_create(&vjoy_log_key, vjoy_log_ring_release);
+}
+
+// Lock free, so a thread's first message never waits on a flush in progress
+static vjoy_log_ring *vjoy_log_ring_get() {
+    if (vjoy_log_local == NULL) {
+        vjoy_log_ring *ring = NULL;
+        pthread_once(&vjoy_log_once, vjoy_log_key_create);
+        for (vjoy_log_ring *r = __atomic_load_n(&vjoy_log_rings, __ATOMIC_ACQUIRE); r != NULL && ring == NULL; r = r->next) {
+            int idle = 1;
+            if (__atomic_compare_exchange_n(&r->idle, &idle, 0, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                ring = r;
+            }
+        }
+        if (ring == NULL) {
+            ring = calloc(1, sizeof(vjoy_log_ring));
+            if (ring == NULL) {
+                return NULL;
+            }
+            // Rings are only ever prepended, never unlinked
+            ring->next = __atomic_load_n(&vjoy_log_rings, __ATOMIC_RELAXED);
+            while (!__atomic_compare_exchange_n(&vjoy_log_rings, &ring->next, ring, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+        }
+        pthread_setspecific(vjoy_log_key, ring);
+        vjoy_log_local = ring;
+    }
+    return vjoy_log_local;
+}
+
+static void vjoy_logv(vjoy_log_level level, const char *fmt, va_list args) {
+    if (!__atomic_load_n(&vjoy_log_running, __ATOMIC_ACQUIRE)) {
+        // Nothing to hand off to yet (startup, tools), print directly
+        char text[VJOY_LOG_LINE];
+        vsnprintf(text, VJOY_LOG_LINE, fmt, args);
+        vjoy_log_print(level, text);
+        return;
+    }
+    vjoy_log_ring *ring = vjoy_log_ring_get();
+    if (ring == NULL) {
+        return;
+    }
+    unsigned head = ring->head;
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= VJOY_LOG_RING) {
+        __atomic_add_fetch(&ring->dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    vjoy_log_entry *entry = &ring->entries[head % VJOY_LOG_RING];
+    entry->level = level;
+    vsnprintf(entry->text, VJOY_LOG_LINE, fmt, args);
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+void vjoy_log(vjoy_log_level level, const char *fmt, ...) {
+    if (!vjoy_log_enabled(level)) {
+        return;
+    }
+    va_list args;
+    va_start(args, fmt);
+    vjoy_logv(level, fmt, args);
+    va_end(args);
+}
+
+// Allows VJOY_LOG_BURST messages per second from a call site, counting the rest
+void vjoy_log_limited(vjoy_log_limit *limit, vjoy_log_level level, const char *fmt, ...) {
+    if (!vjoy_log_enabled(level)) {
+        return;
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    if (__atomic_exchange_n(&limit->window, (long long)ts.tv_sec, __ATOMIC_RELAXED) != ts.tv_sec) {
+        __atomic_store_n(&limit->count, 0, __ATOMIC_RELAXED);
+        unsigned suppressed = __atomic_exchange_n(&limit->suppressed, 0, __ATOMIC_RELAXED);
+        if (suppressed > 0) {
+            vjoy_log(level, "(last message repeated %u more times)", suppressed);
+        }
+    }
+    if (__atomic_add_fetch(&limit->count, 1, __ATOMIC_RELAXED) > VJOY_LOG_BURST) {
+        __atomic_add_fetch(&limit->suppressed, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    va_list args;
+    va_start(args, fmt);
+    vjoy_logv(level, fmt, args);
+    va_end(args);
+}
+
+// Print everything queued so far; safe from any thread
+void vjoy_log_flush() {
+    pthread_mutex_lock(&vjoy_log_lock);
+    for (vjoy_log_ring *ring = __atomic_load_n(&vjoy_log_rings, __ATOMIC_ACQUIRE); ring != NULL; ring = ring->next) {
+        unsigned head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        unsigned tail = ring->tail;
+        while (tail != head) {
+            vjoy_log_entry *entry = &ring->entries[tail % VJOY_LOG_RING];
+            vjoy_log_print(entry->level, entry->text);
+            tail++;
+        }
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+        unsigned long dropped = __atomic_exchange_n(&ring->dropped, 0, __ATOMIC_RELAXED);
+        if (dropped > 0) {
+            fprintf(stderr, "warning: %lu log messages dropped\n", dropped);
+        }
+    }
+    fflush(stdout);
+    fflush(stderr);
+    pthread_mutex_unlock(&vjoy_log_lock);
+}
+
+static void *vjoy_log_loop(void *arg) {
+    struct timespec period = {0, 20000000};
+    while (1) {
+        nanosleep(&period, NULL);
+        vjoy_log_flush();
+    }
+    return NULL;
+}
+
+void vjoy_log_start(vjoy_log_level threshold) {
+    vjoy_log_threshold = threshold;
+    if (vjoy_log_running) {
+        return;
+    }
+    if (pthread_create(&vjoy_log_thread, NULL, vjoy_log_loop, NULL) != 0) {
+        return;
+    }
+    atexit(vjoy_log_flush);
+    __atomic_store_n(&vjoy_log_running, 1, __ATOMIC_RELEASE);
+}
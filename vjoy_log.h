@@ -0,0 +1,33 @@
+#ifndef _VJOY_LOG_H
+#define _VJOY_LOG_H
+
+#define VJOY_LOG_RING  256 // Messages buffered per thread before dropping
+#define VJOY_LOG_LINE  240 // Longest message kept, including the terminator
+#define VJOY_LOG_BURST 5   // Rate limited messages allowed per second
+
+typedef enum _vjoy_log_level {
+    VJOY_LOG_ERROR,
+    VJOY_LOG_WARN,
+    VJOY_LOG_INFO,
+    VJOY_LOG_DEBUG  // Per event chatter, off unless asked for
+} vjoy_log_level;
+
+// Per call site state for vjoy_log_limited(), declare it static
+typedef struct _vjoy_log_limit {
+    long long window;     // Second the current burst started in
+    unsigned  count;      // Messages logged in that second
+    unsigned  suppressed; // Messages dropped since the last one logged
+} vjoy_log_limit;
+
+extern vjoy_log_level vjoy_log_threshold;
+
+#define vjoy_log_enabled(level) ((level) <= vjoy_log_threshold)
+
+void vjoy_log_start(vjoy_log_level threshold);
+void vjoy_log_flush();
+void vjoy_log(vjoy_log_level level, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+void vjoy_log_limited(vjoy_log_limit *limit, vjoy_log_level level, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+#endif /* _VJOY_LOG_H */
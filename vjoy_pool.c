@@ -0,0 +1,149 @@
+#include "vjoy.h"
+#include "vjoy_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Device pool.  Profiles come from -p module:N and are matched on the
+ * capability part of vjoy_info.  Pooled devices are real devices other
+ * programs can see, idle at rest; until a module takes them a reactor
+ * drains their requests and rejects force feedback uploads, see
+ * vjoy_reactor_watch_idle().  Loads, unloads and refills all happen on
+ * the main or control thread.
+ */
+
+static vjoy_pool_profile vjoy_pool[VJOY_POOL_PROFILES];
+static int               vjoy_pool_count  = 0;
+static int               vjoy_pool_serial = 0; // Names pooled devices, past the device table
+static pthread_mutex_t   vjoy_pool_lock   = PTHREAD_MUTEX_INITIALIZER;
+
+static vjoy_pool_profile *vjoy_pool_find(const vjoy_info *info) {
+    for (int i=0; i<vjoy_pool_count; i++) {
+        if (vjoy_info_caps_equal(&vjoy_pool[i].info, info)) {
+            return &vjoy_pool[i];
+        }
+    }
+    return NULL;
+}
+
+static int vjoy_pool_create(vjoy_pool_profile *profile) {
+    vjoy_dev *dev = malloc(sizeof(vjoy_dev));
+    memset(dev, 0, sizeof(vjoy_dev));
+    dev->id      = VJOY_MAX_DEVICES + vjoy_pool_serial++;
+    dev->uifd    = -1;
+    dev->devinfo = profile->info;
+    dev->backend = vjoy_backend_current();
+    strncpy(dev->uidev.name, profile->info.name, UINPUT_MAX_NAME_SIZE);
+    int result = -1;
+    if (dev->backend->open(dev) == 0 && dev->backend->create(dev) == 0) {
+        vjoy_reactor_watch_idle(&profile->watches[profile->count], dev->uifd);
+        profile->uifds[profile->count++] = dev->uifd;
+        result = 0;
+    } else {
+        dev->backend->close(dev);
+    }
+    free(dev);
+    return result;
+}
+
+// Keep N devices like those of a module ready, from "module:N"
+int vjoy_pool_add(const char *spec) {
+    char        name[256];
+    const char *colon = strchr(spec, ':');
+    int         size  = colon != NULL ? atoi(colon + 1) : 1;
+    int         len   = colon != NULL ? (int)(colon - spec) : (int)strlen(spec);
+    if (len <= 0 || len >= (int)sizeof(name) || size <= 0 || size > VJOY_POOL_MAX) {
+        vjoy_log(VJOY_LOG_ERROR, "Pools are given as module:N with N from 1 to %i.", VJOY_POOL_MAX);
+        return -1;
+    }
+    memcpy(name, spec, len);
+    name[len] = '\0';
+
+    vjoy_info *info  = malloc(VJOY_GROUP_MAX * sizeof(vjoy_info));
+    int        count = vjoy_module_info(name, info, VJOY_GROUP_MAX);
+    if (count <= 0) {
+        vjoy_log(VJOY_LOG_ERROR, "Failed to read the devices of %s for the pool.", name);
+        free(info);
+        return -1;
+    }
+    pthread_mutex_lock(&vjoy_pool_lock);
+    for (int i=0; i<count; i++) {
+        vjoy_pool_profile *profile = vjoy_pool_find(&info[i]);
+        if (profile == NULL && vjoy_pool_count < VJOY_POOL_PROFILES) {
+            profile = &vjoy_pool[vjoy_pool_count++];
+            memset(profile, 0, sizeof(vjoy_pool_profile));
+            strncpy(profile->module, name, sizeof(profile->module) - 1);
+            profile->info = info[i];
+        }
+        if (profile == NULL) {
+            vjoy_log(VJOY_LOG_ERROR, "At most %i pool profiles are supported.", VJOY_POOL_PROFILES);
+            break;
+        }
+        profile->target = size;
+        vjoy_log(VJOY_LOG_INFO, "Keeping %i '%s' device(s) ready.", size, profile->info.name);
+    }
+    pthread_mutex_unlock(&vjoy_pool_lock);
+    free(info);
+    vjoy_pool_refill();
+    return 0;
+}
+
+// Hand dev a ready device with its capabilities, if there is one
+int vjoy_pool_take(vjoy_dev *dev) {
+    int result = -1;
+    pthread_mutex_lock(&vjoy_pool_lock);
+    vjoy_pool_profile *profile = vjoy_pool_find(&dev->devinfo);
+    if (profile != NULL && profile->count > 0) {
+        dev->uifd = profile->uifds[--profile->count];
+        vjoy_reactor_unwatch_idle(&profile->watches[profile->count]);
+        result    = 0;
+    }
+    pthread_mutex_unlock(&vjoy_pool_lock);
+    return result;
+}
+
+int vjoy_pool_wants(const vjoy_info *info) {
+    pthread_mutex_lock(&vjoy_pool_lock);
+    vjoy_pool_profile *profile = vjoy_pool_find(info);
+    int                wants   = profile != NULL && profile->count < profile->target;
+    pthread_mutex_unlock(&vjoy_pool_lock);
+    return wants;
+}
+
+// Keep an unloaded device for the next module, if its pool is short of one
+int vjoy_pool_put(vjoy_dev *dev) {
+    int result = -1;
+    pthread_mutex_lock(&vjoy_pool_lock);
+    vjoy_pool_profile *profile = vjoy_pool_find(&dev->devinfo);
+    if (profile != NULL && profile->count < profile->target) {
+        vjoy_reactor_watch_idle(&profile->watches[profile->count], dev->uifd);
+        profile->uifds[profile->count++] = dev->uifd;
+        dev->uifd = -1;
+        result    = 0;
+    }
+    pthread_mutex_unlock(&vjoy_pool_lock);
+    return result;
+}
+
+// Create devices until every profile is back at its target
+void vjoy_pool_refill() {
+    pthread_mutex_lock(&vjoy_pool_lock);
+    for (int i=0; i<vjoy_pool_count; i++) {
+        while (vjoy_pool[i].count < vjoy_pool[i].target) {
+            if (vjoy_pool_create(&vjoy_pool[i]) < 0) {
+                vjoy_log(VJOY_LOG_ERROR, "Failed to pre-create a '%s' device.", vjoy_pool[i].info.name);
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&vjoy_pool_lock);
+}
+
+void vjoy_pool_report(FILE *out) {
+    pthread_mutex_lock(&vjoy_pool_lock);
+    for (int i=0; i<vjoy_pool_count; i++) {
+        fprintf(out, "%s\t%i/%i\t%s\n", vjoy_pool[i].module, vjoy_pool[i].count,
+                vjoy_pool[i].target, vjoy_pool[i].info.name);
+    }
+    pthread_mutex_unlock(&vjoy_pool_lock);
+}
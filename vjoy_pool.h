@@ -0,0 +1,27 @@
+#ifndef _VJOY_POOL_H
+#define _VJOY_POOL_H
+
+#define VJOY_POOL_PROFILES 16 // Distinct capability sets kept ready
+#define VJOY_POOL_MAX      32 // Devices kept ready per capability set
+
+/* Pre-created devices.  Creating a uinput device and waiting for udev to
+ * settle takes a noticeable while; with a pool, a module whose devices
+ * match a profile is handed one that already exists.
+ */
+typedef struct _vjoy_pool_profile {
+    char      module[256];           // Module the capabilities were read from
+    vjoy_info info;
+    int       target;                // Devices to keep ready
+    int       count;
+    int       uifds[VJOY_POOL_MAX];  // Ready devices, as their backend descriptors
+    vjoy_watch watches[VJOY_POOL_MAX]; // Draining each of them until taken
+} vjoy_pool_profile;
+
+int  vjoy_pool_add(const char *spec);
+int  vjoy_pool_take(vjoy_dev *dev);
+int  vjoy_pool_wants(const vjoy_info *info);
+int  vjoy_pool_put(vjoy_dev *dev);
+void vjoy_pool_refill();
+void vjoy_pool_report(FILE *out);
+
+#endif /* _VJOY_POOL_H */
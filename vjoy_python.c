@@ -1,16 +1,763 @@
 #include "vjoy_python.h"
+#include <stddef.h>
+#include <string.h>
+
+/* Look up a device for the native event API.  Only devices driven by the
+ * calling interpreter may be touched; anything else belongs to another
+ * reactor thread.
+ */
+static vjoy_dev *vjoy_py_device(int id) {
+    vjoy_dev *dev = vjoy_get_device(id);
+    if (dev == NULL) {
+        PyErr_Format(PyExc_ValueError, "No device with id %i", id);
+        return NULL;
+    }
+    if (dev->pystate->interp != PyThreadState_GET()->interp) {
+        PyErr_Format(PyExc_ValueError, "Device %i is not driven by this module", id);
+        return NULL;
+    }
+    return dev;
+}
+
+static PyObject *vjoy_py_send_event(PyObject *self, PyObject *args) {
+    int id, type, code, value;
+    if (!PyArg_ParseTuple(args, "iiii:send_event", &id, &type, &code, &value)) {
+        return NULL;
+    }
+    vjoy_dev *dev = vjoy_py_device(id);
+    if (dev == NULL) {
+        return NULL;
+    }
+    vjoy_dev_emit(dev, type, code, value);
+    Py_RETURN_NONE;
+}
+
+static PyObject *vjoy_py_set_axis(PyObject *self, PyObject *args) {
+    int id, code, value;
+    if (!PyArg_ParseTuple(args, "iii:set_axis", &id, &code, &value)) {
+        return NULL;
+    }
+    vjoy_dev *dev = vjoy_py_device(id);
+    if (dev == NULL) {
+        return NULL;
+    }
+    vjoy_dev_emit(dev, EV_ABS, code, value);
+    Py_RETURN_NONE;
+}
+
+// Bit i of the mask drives the device's buttons[first+i]
+static PyObject *vjoy_py_set_buttons(PyObject *self, PyObject *args) {
+    int       id, first = 0;
+    PyObject *pymask;
+    if (!PyArg_ParseTuple(args, "iO|i:set_buttons", &id, &pymask, &first)) {
+        return NULL;
+    }
+    vjoy_dev *dev = vjoy_py_device(id);
+    if (dev == NULL) {
+        return NULL;
+    }
+    unsigned long long mask = PyInt_AsUnsignedLongLongMask(pymask);
+    if (PyErr_Occurred() != NULL) {
+        return NULL;
+    }
+    if (first < 0) {
+        PyErr_SetString(PyExc_ValueError, "First button index must not be negative");
+        return NULL;
+    }
+    int count = dev->devinfo.buttoncount - first;
+    if (count > 64) count = 64;
+    for (int i=0; i<count; i++) {
+        vjoy_dev_emit(dev, EV_KEY, dev->devinfo.buttons[first+i], (mask >> i) & 1);
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *vjoy_py_syn(PyObject *self, PyObject *args) {
+    int id;
+    if (!PyArg_ParseTuple(args, "i:syn", &id)) {
+        return NULL;
+    }
+    vjoy_dev *dev = vjoy_py_device(id);
+    if (dev == NULL) {
+        return NULL;
+    }
+    vjoy_dev_emit(dev, EV_SYN, SYN_REPORT, 0);
+    Py_RETURN_NONE;
+}
+
+// Force feedback output mixed by vjoy for the current tick
+static PyObject *vjoy_py_get_force(PyObject *self, PyObject *args) {
+    int id;
+    if (!PyArg_ParseTuple(args, "i:get_force", &id)) {
+        return NULL;
+    }
+    vjoy_dev *dev = vjoy_py_device(id);
+    if (dev == NULL) {
+        return NULL;
+    }
+    vjoy_ff_output *out = &dev->ff.output;
+    return Py_BuildValue("(iiii)", out->force[0], out->force[1], out->strong, out->weak);
+}
+
+// Raw samples for the device's transform pipeline, channels first, first+1, ...
+static PyObject *vjoy_py_set_raw(PyObject *self, PyObject *args) {
+    int       id, first = 0;
+    PyObject *pyvalues;
+    if (!PyArg_ParseTuple(args, "iO|i:set_raw", &id, &pyvalues, &first)) {
+        return NULL;
+    }
+    vjoy_dev *dev = vjoy_py_device(id);
+    if (dev == NULL) {
+        return NULL;
+    }
+    PyObject *seq = PySequence_Fast(pyvalues, "Raw samples must be a sequence of ints");
+    if (seq == NULL) {
+        return NULL;
+    }
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(seq);
+    if (first < 0 || first + count > VJOY_RAW_MAX) {
+        Py_DECREF(seq);
+        PyErr_Format(PyExc_ValueError, "Raw channels must be in [0, %i)", VJOY_RAW_MAX);
+        return NULL;
+    }
+    PyObject **items = PySequence_Fast_ITEMS(seq);
+    for (Py_ssize_t i=0; i<count; i++) {
+        long value = PyInt_AsLong(items[i]);
+        if (value == -1 && PyErr_Occurred() != NULL) {
+            Py_DECREF(seq);
+            return NULL;
+        }
+        dev->transform.raw[first + i] = value;
+    }
+    dev->transform.dirty = 1;
+    Py_DECREF(seq);
+    Py_RETURN_NONE;
+}
+
+// Descriptors may be given as ints or as anything with a fileno()
+static PyObject *vjoy_py_watch_fd(PyObject *self, PyObject *args) {
+    int       id;
+    PyObject *pyfd;
+    if (!PyArg_ParseTuple(args, "iO:watch_fd", &id, &pyfd)) {
+        return NULL;
+    }
+    vjoy_dev *dev = vjoy_py_device(id);
+    if (dev == NULL) {
+        return NULL;
+    }
+    int fd = PyObject_AsFileDescriptor(pyfd);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (!PyObject_HasAttrString(dev->pymodule, "doVJoyRead")) {
+        PyErr_SetString(PyExc_AttributeError, "Watching fds requires a doVJoyRead(fd) callback");
+        return NULL;
+    }
+    if (vjoy_dev_watch_fd(dev, fd) < 0) {
+        PyErr_Format(PyExc_RuntimeError, "Could not watch fd %i", fd);
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *vjoy_py_unwatch_fd(PyObject *self, PyObject *args) {
+    int       id;
+    PyObject *pyfd;
+    if (!PyArg_ParseTuple(args, "iO:unwatch_fd", &id, &pyfd)) {
+        return NULL;
+    }
+    vjoy_dev *dev = vjoy_py_device(id);
+    if (dev == NULL) {
+        return NULL;
+    }
+    int fd = PyObject_AsFileDescriptor(pyfd);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (vjoy_dev_unwatch_fd(dev, fd) < 0) {
+        PyErr_Format(PyExc_ValueError, "fd %i is not being watched", fd);
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+/* Requests a doVJoyThink() generator yields instead of a frame, to be
+ * resumed at a given time or once an fd is readable rather than at the
+ * next tick.  Deadlines are in seconds on CLOCK_MONOTONIC, like vjoy.now().
+ */
+PyTypeObject vjoy_py_wake_type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name      = "vjoy.Wake",
+    .tp_basicsize = sizeof(vjoy_py_wake),
+    .tp_flags     = Py_TPFLAGS_DEFAULT,
+    .tp_doc       = "When a doVJoyThink() generator wants to be resumed"
+};
+
+static PyObject *vjoy_py_new_wake(double deadline, int fd) {
+    vjoy_py_wake *wake = PyObject_New(vjoy_py_wake, &vjoy_py_wake_type);
+    if (wake == NULL) {
+        return NULL;
+    }
+    wake->deadline = deadline;
+    wake->fd       = fd;
+    return (PyObject*)wake;
+}
+
+static PyObject *vjoy_py_now(PyObject *self, PyObject *args) {
+    return PyFloat_FromDouble(vjoy_stats_now() / 1e9);
+}
+
+static PyObject *vjoy_py_sleep(PyObject *self, PyObject *args) {
+    double seconds;
+    if (!PyArg_ParseTuple(args, "d:sleep", &seconds)) {
+        return NULL;
+    }
+    return vjoy_py_new_wake(vjoy_stats_now() / 1e9 + (seconds > 0 ? seconds : 0), -1);
+}
+
+static PyObject *vjoy_py_until(PyObject *self, PyObject *args) {
+    double deadline;
+    if (!PyArg_ParseTuple(args, "d:until", &deadline)) {
+        return NULL;
+    }
+    return vjoy_py_new_wake(deadline > 0 ? deadline : 0, -1);
+}
+
+static PyObject *vjoy_py_wait_fd(PyObject *self, PyObject *args) {
+    PyObject *pyfd, *pytimeout = Py_None;
+    if (!PyArg_ParseTuple(args, "O|O:wait_fd", &pyfd, &pytimeout)) {
+        return NULL;
+    }
+    int fd = PyObject_AsFileDescriptor(pyfd);
+    if (fd < 0) {
+        return NULL;
+    }
+    // A negative deadline waits on the fd alone
+    double deadline = -1;
+    if (pytimeout != Py_None) {
+        double timeout = PyFloat_AsDouble(pytimeout);
+        if (PyErr_Occurred() != NULL) {
+            return NULL;
+        }
+        deadline = vjoy_stats_now() / 1e9 + (timeout > 0 ? timeout : 0);
+    }
+    return vjoy_py_new_wake(deadline, fd);
+}
 
 static PyMethodDef vjoy_py_module_methods[] = {
+    {"send_event",  vjoy_py_send_event,  METH_VARARGS,
+     "send_event(id, type, code, value) -- stage an event in the device's frame"},
+    {"set_axis",    vjoy_py_set_axis,    METH_VARARGS,
+     "set_axis(id, code, value) -- stage an EV_ABS event"},
+    {"set_buttons", vjoy_py_set_buttons, METH_VARARGS,
+     "set_buttons(id, mask[, first]) -- bit i sets the state of buttons[first+i]"},
+    {"syn",         vjoy_py_syn,         METH_VARARGS,
+     "syn(id) -- end the current frame with a SYN_REPORT"},
+    {"get_force",   vjoy_py_get_force,   METH_VARARGS,
+     "get_force(id) -- (x, y, strong, weak) mix of every playing feedback effect"},
+    {"set_raw",     vjoy_py_set_raw,     METH_VARARGS,
+     "set_raw(id, samples[, first]) -- feed raw channels to the 'transforms' pipeline"},
+    {"watch_fd",    vjoy_py_watch_fd,    METH_VARARGS,
+     "watch_fd(id, fd) -- call doVJoyRead(fd) whenever fd becomes readable"},
+    {"unwatch_fd",  vjoy_py_unwatch_fd,  METH_VARARGS,
+     "unwatch_fd(id, fd) -- stop watching fd"},
+    {"now",         vjoy_py_now,         METH_NOARGS,
+     "now() -- seconds on the clock until() deadlines are given on"},
+    {"sleep",       vjoy_py_sleep,       METH_VARARGS,
+     "sleep(seconds) -- yield from doVJoyThink() to be resumed that much later"},
+    {"until",       vjoy_py_until,       METH_VARARGS,
+     "until(t) -- yield from doVJoyThink() to be resumed once now() reaches t"},
+    {"wait_fd",     vjoy_py_wait_fd,     METH_VARARGS,
+     "wait_fd(fd[, timeout]) -- yield from doVJoyThink() to be resumed once fd is readable;\n"
+     "the generator is sent True then, or False if the timeout ran out first"},
+    {NULL, NULL, 0, NULL}
+};
+
+/* Report and clear the pending exception through vjoy_log(), one line at a
+ * time, instead of PyErr_Print() writing straight to stderr from a reactor.
+ */
+void vjoy_py_log_error() {
+    PyObject *type, *value, *tb;
+    PyErr_Fetch(&type, &value, &tb);
+    if (type == NULL) {
+        return;
+    }
+    PyErr_NormalizeException(&type, &value, &tb);
+    PyObject *lines     = NULL;
+    PyObject *traceback = PyImport_ImportModule("traceback");
+    if (traceback != NULL) {
+        lines = PyObject_CallMethod(traceback, "format_exception", "OOO",
+                                    type, value != NULL ? value : Py_None, tb != NULL ? tb : Py_None);
+        Py_DECREF(traceback);
+    }
+    if (lines == NULL || !PyList_Check(lines)) {
+        // Not even the traceback module works, fall back to Python's own output
+        Py_XDECREF(lines);
+        PyErr_Clear();
+        PyErr_Restore(type, value, tb);
+        PyErr_Print();
+        return;
+    }
+    for (Py_ssize_t i=0; i<PyList_GET_SIZE(lines); i++) {
+        const char *text = PyString_AsString(PyList_GET_ITEM(lines, i));
+        if (text == NULL) {
+            PyErr_Clear();
+            continue;
+        }
+        // Entries hold several newline-terminated lines
+        while (*text != '\0') {
+            const char *end = strchr(text, '\n');
+            int         len = end != NULL ? (int)(end - text) : (int)strlen(text);
+            vjoy_log(VJOY_LOG_ERROR, "%.*s", len, text);
+            text += len + (end != NULL);
+        }
+    }
+    Py_DECREF(lines);
+    Py_XDECREF(type);
+    Py_XDECREF(value);
+    Py_XDECREF(tb);
+}
+
+/* Every device runs in its own sub-interpreter.  A device's thread state is
+ * only ever used by one thread at a time (the loader, then its reactor), so
+ * entering it is just a matter of taking the GIL with it.
+ */
+void vjoy_py_enter(vjoy_dev *dev) {
+    unsigned long long started = vjoy_stats_now();
+    PyEval_RestoreThread(dev->pystate);
+    vjoy_hist_record(&dev->stats.gilwait, vjoy_stats_now() - started);
+}
+
+void vjoy_py_leave(vjoy_dev *dev) {
+    PyEval_SaveThread();
+}
+
+// Must be called with the GIL held; leaves the new interpreter current
+PyThreadState *vjoy_py_new_interpreter(const char *path) {
+    PyThreadState *state = Py_NewInterpreter();
+    if (state == NULL) {
+        return NULL;
+    }
+    PySys_SetPath((char*)path);
+    vjoy_py_initialize();
+    return state;
+}
+
+/* Force feedback effects are handed to modules as read-only mapping objects
+ * backed directly by a copy of the kernel's struct ff_effect.  Nested parts
+ * (trigger, replay, envelope, ...) are views into the same copy, created only
+ * when a module asks for them, and field names are interned once so lookups
+ * are a pointer comparison in the common case.
+ */
+typedef enum _vjoy_ff_kind {
+    VJOY_FF_U16,
+    VJOY_FF_S16,
+    VJOY_FF_STRUCT,    // Nested view described by another table
+    VJOY_FF_CONDITION  // Tuple of two views, one per axis
+} vjoy_ff_kind;
+
+struct _vjoy_ff_table;
+
+typedef struct _vjoy_ff_field {
+    const char                  *name;
+    vjoy_ff_kind                 kind;
+    size_t                       offset;
+    const struct _vjoy_ff_table *table;  // Layout of VJOY_FF_STRUCT/CONDITION
+    unsigned int                 types;  // Effect types it applies to, 0 for all
+    PyObject                    *pyname; // Interned name
+} vjoy_ff_field;
+
+typedef struct _vjoy_ff_table {
+    int            count;
+    vjoy_ff_field *fields;
+} vjoy_ff_table;
+
+#define VJOY_FF_TYPE(t)       (1u << ((t) - FF_EFFECT_MIN))
+#define VJOY_FF_CONDITIONS    (VJOY_FF_TYPE(FF_SPRING) | VJOY_FF_TYPE(FF_FRICTION) | \
+                               VJOY_FF_TYPE(FF_DAMPER) | VJOY_FF_TYPE(FF_INERTIA))
+#define VJOY_FF_FIELD(s,f,k)  {#f, k, offsetof(s, f), NULL, 0, NULL}
+#define VJOY_FF_TABLE(f)      {sizeof(f)/sizeof(vjoy_ff_field), f}
+
+static vjoy_ff_field vjoy_ff_envelope_fields[] = {
+    VJOY_FF_FIELD(struct ff_envelope, attack_length, VJOY_FF_U16),
+    VJOY_FF_FIELD(struct ff_envelope, attack_level,  VJOY_FF_U16),
+    VJOY_FF_FIELD(struct ff_envelope, fade_length,   VJOY_FF_U16),
+    VJOY_FF_FIELD(struct ff_envelope, fade_level,    VJOY_FF_U16)
+};
+static const vjoy_ff_table vjoy_ff_envelope = VJOY_FF_TABLE(vjoy_ff_envelope_fields);
+
+static vjoy_ff_field vjoy_ff_trigger_fields[] = {
+    VJOY_FF_FIELD(struct ff_trigger, button,   VJOY_FF_U16),
+    VJOY_FF_FIELD(struct ff_trigger, interval, VJOY_FF_U16)
+};
+static const vjoy_ff_table vjoy_ff_trigger = VJOY_FF_TABLE(vjoy_ff_trigger_fields);
+
+static vjoy_ff_field vjoy_ff_replay_fields[] = {
+    VJOY_FF_FIELD(struct ff_replay, length, VJOY_FF_U16),
+    VJOY_FF_FIELD(struct ff_replay, delay,  VJOY_FF_U16)
+};
+static const vjoy_ff_table vjoy_ff_replay = VJOY_FF_TABLE(vjoy_ff_replay_fields);
+
+static vjoy_ff_field vjoy_ff_constant_fields[] = {
+    VJOY_FF_FIELD(struct ff_constant_effect, level, VJOY_FF_S16),
+    {"envelope", VJOY_FF_STRUCT, offsetof(struct ff_constant_effect, envelope), &vjoy_ff_envelope, 0, NULL}
+};
+static const vjoy_ff_table vjoy_ff_constant = VJOY_FF_TABLE(vjoy_ff_constant_fields);
+
+static vjoy_ff_field vjoy_ff_periodic_fields[] = {
+    VJOY_FF_FIELD(struct ff_periodic_effect, waveform,  VJOY_FF_U16),
+    VJOY_FF_FIELD(struct ff_periodic_effect, period,    VJOY_FF_U16),
+    VJOY_FF_FIELD(struct ff_periodic_effect, magnitude, VJOY_FF_S16),
+    VJOY_FF_FIELD(struct ff_periodic_effect, offset,    VJOY_FF_S16),
+    VJOY_FF_FIELD(struct ff_periodic_effect, phase,     VJOY_FF_U16),
+    {"envelope", VJOY_FF_STRUCT, offsetof(struct ff_periodic_effect, envelope), &vjoy_ff_envelope, 0, NULL}
+};
+static const vjoy_ff_table vjoy_ff_periodic = VJOY_FF_TABLE(vjoy_ff_periodic_fields);
+
+static vjoy_ff_field vjoy_ff_ramp_fields[] = {
+    VJOY_FF_FIELD(struct ff_ramp_effect, start_level, VJOY_FF_S16),
+    VJOY_FF_FIELD(struct ff_ramp_effect, end_level,   VJOY_FF_S16),
+    {"envelope", VJOY_FF_STRUCT, offsetof(struct ff_ramp_effect, envelope), &vjoy_ff_envelope, 0, NULL}
+};
+static const vjoy_ff_table vjoy_ff_ramp = VJOY_FF_TABLE(vjoy_ff_ramp_fields);
+
+static vjoy_ff_field vjoy_ff_condition_fields[] = {
+    VJOY_FF_FIELD(struct ff_condition_effect, right_saturation, VJOY_FF_U16),
+    VJOY_FF_FIELD(struct ff_condition_effect, left_saturation,  VJOY_FF_U16),
+    VJOY_FF_FIELD(struct ff_condition_effect, right_coeff,      VJOY_FF_S16),
+    VJOY_FF_FIELD(struct ff_condition_effect, left_coeff,       VJOY_FF_S16),
+    VJOY_FF_FIELD(struct ff_condition_effect, deadband,         VJOY_FF_U16),
+    VJOY_FF_FIELD(struct ff_condition_effect, center,           VJOY_FF_S16)
+};
+static const vjoy_ff_table vjoy_ff_condition = VJOY_FF_TABLE(vjoy_ff_condition_fields);
+
+static vjoy_ff_field vjoy_ff_rumble_fields[] = {
+    VJOY_FF_FIELD(struct ff_rumble_effect, strong_magnitude, VJOY_FF_U16),
+    VJOY_FF_FIELD(struct ff_rumble_effect, weak_magnitude,   VJOY_FF_U16)
+};
+static const vjoy_ff_table vjoy_ff_rumble = VJOY_FF_TABLE(vjoy_ff_rumble_fields);
+
+static vjoy_ff_field vjoy_ff_effect_fields[] = {
+    VJOY_FF_FIELD(struct ff_effect, type,      VJOY_FF_U16),
+    VJOY_FF_FIELD(struct ff_effect, id,        VJOY_FF_S16),
+    VJOY_FF_FIELD(struct ff_effect, direction, VJOY_FF_U16),
+    {"trigger",   VJOY_FF_STRUCT,    offsetof(struct ff_effect, trigger), &vjoy_ff_trigger, 0, NULL},
+    {"replay",    VJOY_FF_STRUCT,    offsetof(struct ff_effect, replay),  &vjoy_ff_replay,  0, NULL},
+    {"constant",  VJOY_FF_STRUCT,    offsetof(struct ff_effect, u), &vjoy_ff_constant,
+     VJOY_FF_TYPE(FF_CONSTANT), NULL},
+    {"periodic",  VJOY_FF_STRUCT,    offsetof(struct ff_effect, u), &vjoy_ff_periodic,
+     VJOY_FF_TYPE(FF_PERIODIC), NULL},
+    {"ramp",      VJOY_FF_STRUCT,    offsetof(struct ff_effect, u), &vjoy_ff_ramp,
+     VJOY_FF_TYPE(FF_RAMP), NULL},
+    {"condition", VJOY_FF_CONDITION, offsetof(struct ff_effect, u), &vjoy_ff_condition,
+     VJOY_FF_CONDITIONS, NULL},
+    {"rumble",    VJOY_FF_STRUCT,    offsetof(struct ff_effect, u), &vjoy_ff_rumble,
+     VJOY_FF_TYPE(FF_RUMBLE), NULL}
+};
+static const vjoy_ff_table vjoy_ff_effect = VJOY_FF_TABLE(vjoy_ff_effect_fields);
+
+static vjoy_ff_field *vjoy_ff_tables[] = {
+    vjoy_ff_envelope_fields, vjoy_ff_trigger_fields, vjoy_ff_replay_fields,
+    vjoy_ff_constant_fields, vjoy_ff_periodic_fields, vjoy_ff_ramp_fields,
+    vjoy_ff_condition_fields, vjoy_ff_rumble_fields, vjoy_ff_effect_fields
+};
+static const vjoy_ff_table *vjoy_ff_table_sizes[] = {
+    &vjoy_ff_envelope, &vjoy_ff_trigger, &vjoy_ff_replay,
+    &vjoy_ff_constant, &vjoy_ff_periodic, &vjoy_ff_ramp,
+    &vjoy_ff_condition, &vjoy_ff_rumble, &vjoy_ff_effect
+};
+
+typedef struct _vjoy_py_ff {
+    PyObject_HEAD
+    PyObject            *owner;  // Effect owning the memory, NULL for the effect itself
+    char                *data;   // Start of the struct this object describes
+    const vjoy_ff_table *table;
+    struct ff_effect     effect; // Only present in FeedbackEffect objects
+} vjoy_py_ff;
+
+static PyTypeObject vjoy_py_ff_effect_type;
+static PyTypeObject vjoy_py_ff_struct_type;
+
+static PyObject *vjoy_py_ff_view(PyObject *owner, char *data, const vjoy_ff_table *table) {
+    vjoy_py_ff *view = PyObject_New(vjoy_py_ff, &vjoy_py_ff_struct_type);
+    if (view == NULL) {
+        return NULL;
+    }
+    Py_INCREF(owner);
+    view->owner = owner;
+    view->data  = data;
+    view->table = table;
+    return (PyObject*)view;
+}
+
+static PyObject *vjoy_py_ff_root(vjoy_py_ff *self) {
+    return self->owner != NULL ? self->owner : (PyObject*)self;
+}
+
+// Whether a field exists for this particular effect (union members depend on type)
+static int vjoy_py_ff_visible(vjoy_py_ff *self, const vjoy_ff_field *field) {
+    if (field->types == 0) {
+        return 1;
+    }
+    const vjoy_py_ff *root = (vjoy_py_ff*)vjoy_py_ff_root(self);
+    int type = root->effect.type;
+    return type >= FF_EFFECT_MIN && type <= FF_EFFECT_MAX &&
+           (field->types & VJOY_FF_TYPE(type)) != 0;
+}
+
+static const vjoy_ff_field *vjoy_py_ff_find(vjoy_py_ff *self, PyObject *key) {
+    const vjoy_ff_table *table = self->table;
+    for (int i=0; i<table->count; i++) {
+        if (table->fields[i].pyname == key) {
+            return vjoy_py_ff_visible(self, &table->fields[i]) ? &table->fields[i] : NULL;
+        }
+    }
+    if (!PyString_Check(key)) {
+        return NULL;
+    }
+    const char *name = PyString_AS_STRING(key);
+    for (int i=0; i<table->count; i++) {
+        if (strcmp(table->fields[i].name, name) == 0) {
+            return vjoy_py_ff_visible(self, &table->fields[i]) ? &table->fields[i] : NULL;
+        }
+    }
+    return NULL;
+}
+
+static PyObject *vjoy_py_ff_value(vjoy_py_ff *self, const vjoy_ff_field *field) {
+    char *data = self->data + field->offset;
+    switch (field->kind) {
+        case VJOY_FF_U16: {
+            __u16 value;
+            memcpy(&value, data, sizeof(value));
+            return PyInt_FromLong(value);
+        }
+        case VJOY_FF_S16: {
+            __s16 value;
+            memcpy(&value, data, sizeof(value));
+            return PyInt_FromLong(value);
+        }
+        case VJOY_FF_STRUCT:
+            return vjoy_py_ff_view(vjoy_py_ff_root(self), data, field->table);
+        case VJOY_FF_CONDITION: {
+            PyObject *axes[2];
+            for (int i=0; i<2; i++) {
+                axes[i] = vjoy_py_ff_view(vjoy_py_ff_root(self),
+                                          data + i*sizeof(struct ff_condition_effect),
+                                          field->table);
+            }
+            PyObject *pycondition = NULL;
+            if (axes[0] != NULL && axes[1] != NULL) {
+                pycondition = PyTuple_Pack(2, axes[0], axes[1]);
+            }
+            Py_XDECREF(axes[0]);
+            Py_XDECREF(axes[1]);
+            return pycondition;
+        }
+    }
+    return NULL;
+}
+
+static void vjoy_py_ff_dealloc(vjoy_py_ff *self) {
+    Py_XDECREF(self->owner);
+    PyObject_Del(self);
+}
+
+static Py_ssize_t vjoy_py_ff_length(vjoy_py_ff *self) {
+    Py_ssize_t count = 0;
+    for (int i=0; i<self->table->count; i++) {
+        count += vjoy_py_ff_visible(self, &self->table->fields[i]);
+    }
+    return count;
+}
+
+static PyObject *vjoy_py_ff_subscript(vjoy_py_ff *self, PyObject *key) {
+    const vjoy_ff_field *field = vjoy_py_ff_find(self, key);
+    if (field == NULL) {
+        PyErr_SetObject(PyExc_KeyError, key);
+        return NULL;
+    }
+    return vjoy_py_ff_value(self, field);
+}
+
+static int vjoy_py_ff_contains(vjoy_py_ff *self, PyObject *key) {
+    return vjoy_py_ff_find(self, key) != NULL;
+}
+
+// Attribute access mirrors item access, so effect.rumble.weak_magnitude works too
+static PyObject *vjoy_py_ff_getattro(vjoy_py_ff *self, PyObject *name) {
+    const vjoy_ff_field *field = vjoy_py_ff_find(self, name);
+    if (field != NULL) {
+        return vjoy_py_ff_value(self, field);
+    }
+    return PyObject_GenericGetAttr((PyObject*)self, name);
+}
+
+static PyObject *vjoy_py_ff_keys(vjoy_py_ff *self) {
+    PyObject *keys = PyList_New(0);
+    for (int i=0; keys != NULL && i<self->table->count; i++) {
+        if (vjoy_py_ff_visible(self, &self->table->fields[i]) &&
+            PyList_Append(keys, self->table->fields[i].pyname) < 0) {
+            Py_CLEAR(keys);
+        }
+    }
+    return keys;
+}
+
+static PyObject *vjoy_py_ff_get(vjoy_py_ff *self, PyObject *args) {
+    PyObject *key, *def = Py_None;
+    if (!PyArg_UnpackTuple(args, "get", 1, 2, &key, &def)) {
+        return NULL;
+    }
+    const vjoy_ff_field *field = vjoy_py_ff_find(self, key);
+    if (field == NULL) {
+        Py_INCREF(def);
+        return def;
+    }
+    return vjoy_py_ff_value(self, field);
+}
+
+static PyObject *vjoy_py_ff_iter(vjoy_py_ff *self) {
+    PyObject *keys = vjoy_py_ff_keys(self);
+    if (keys == NULL) {
+        return NULL;
+    }
+    PyObject *iter = PyObject_GetIter(keys);
+    Py_DECREF(keys);
+    return iter;
+}
+
+// Deep copy into plain dicts, for modules that want to keep an effect around
+static PyObject *vjoy_py_ff_to_dict(vjoy_py_ff *self) {
+    PyObject *dict = PyDict_New();
+    for (int i=0; dict != NULL && i<self->table->count; i++) {
+        const vjoy_ff_field *field = &self->table->fields[i];
+        if (!vjoy_py_ff_visible(self, field)) {
+            continue;
+        }
+        PyObject *value = vjoy_py_ff_value(self, field);
+        if (value != NULL && field->kind == VJOY_FF_STRUCT) {
+            PyObject *sub = vjoy_py_ff_to_dict((vjoy_py_ff*)value);
+            Py_DECREF(value);
+            value = sub;
+        } else if (value != NULL && field->kind == VJOY_FF_CONDITION) {
+            PyObject *axes[2] = {vjoy_py_ff_to_dict((vjoy_py_ff*)PyTuple_GET_ITEM(value, 0)),
+                                 vjoy_py_ff_to_dict((vjoy_py_ff*)PyTuple_GET_ITEM(value, 1))};
+            Py_DECREF(value);
+            value = (axes[0] && axes[1]) ? PyTuple_Pack(2, axes[0], axes[1]) : NULL;
+            Py_XDECREF(axes[0]);
+            Py_XDECREF(axes[1]);
+        }
+        if (value == NULL || PyDict_SetItem(dict, field->pyname, value) < 0) {
+            Py_CLEAR(dict);
+        }
+        Py_XDECREF(value);
+    }
+    return dict;
+}
+
+static PyObject *vjoy_py_ff_repr(vjoy_py_ff *self) {
+    PyObject *dict = vjoy_py_ff_to_dict(self);
+    if (dict == NULL) {
+        return NULL;
+    }
+    PyObject *repr = PyObject_Repr(dict);
+    Py_DECREF(dict);
+    return repr;
+}
+
+static PyMappingMethods vjoy_py_ff_mapping = {
+    (lenfunc)vjoy_py_ff_length,
+    (binaryfunc)vjoy_py_ff_subscript,
+    NULL
+};
+
+static PySequenceMethods vjoy_py_ff_sequence = {
+    .sq_contains = (objobjproc)vjoy_py_ff_contains
+};
+
+static PyMethodDef vjoy_py_ff_methods[] = {
+    {"keys",    (PyCFunction)vjoy_py_ff_keys,    METH_NOARGS,  "List of field names"},
+    {"get",     (PyCFunction)vjoy_py_ff_get,     METH_VARARGS, "get(key[, default])"},
+    {"to_dict", (PyCFunction)vjoy_py_ff_to_dict, METH_NOARGS,  "Copy into nested dicts"},
     {NULL, NULL, 0, NULL}
 };
 
+#define VJOY_PY_FF_TYPE(n, size, doc) {                          \
+    PyVarObject_HEAD_INIT(NULL, 0)                               \
+    .tp_name        = n,                                         \
+    .tp_basicsize   = size,                                      \
+    .tp_dealloc     = (destructor)vjoy_py_ff_dealloc,            \
+    .tp_repr        = (reprfunc)vjoy_py_ff_repr,                 \
+    .tp_as_sequence = &vjoy_py_ff_sequence,                      \
+    .tp_as_mapping  = &vjoy_py_ff_mapping,                       \
+    .tp_getattro    = (getattrofunc)vjoy_py_ff_getattro,         \
+    .tp_flags       = Py_TPFLAGS_DEFAULT,                        \
+    .tp_doc         = doc,                                       \
+    .tp_iter        = (getiterfunc)vjoy_py_ff_iter,              \
+    .tp_methods     = vjoy_py_ff_methods                         \
+}
+
+static PyTypeObject vjoy_py_ff_effect_type = VJOY_PY_FF_TYPE("vjoy.FeedbackEffect",
+    sizeof(vjoy_py_ff), "Force feedback effect uploaded by an application");
+static PyTypeObject vjoy_py_ff_struct_type = VJOY_PY_FF_TYPE("vjoy.FeedbackStruct",
+    offsetof(vjoy_py_ff, effect), "Part of a force feedback effect");
+
+// Interned names and types are shared by every interpreter, set them up once
+static int vjoy_py_ff_initialize() {
+    static int ready = 0;
+    if (ready) {
+        return 0;
+    }
+    int tables = sizeof(vjoy_ff_tables)/sizeof(vjoy_ff_field*);
+    for (int t=0; t<tables; t++) {
+        for (int i=0; i<vjoy_ff_table_sizes[t]->count; i++) {
+            vjoy_ff_tables[t][i].pyname = PyString_InternFromString(vjoy_ff_tables[t][i].name);
+            if (vjoy_ff_tables[t][i].pyname == NULL) {
+                return -1;
+            }
+        }
+    }
+    if (PyType_Ready(&vjoy_py_ff_effect_type) < 0 ||
+        PyType_Ready(&vjoy_py_ff_struct_type) < 0) {
+        return -1;
+    }
+    ready = 1;
+    return 0;
+}
+
+PyObject *vjoy_convert_ff_effect(struct ff_effect *effect) {
+    vjoy_py_ff *pyeffect = PyObject_New(vjoy_py_ff, &vjoy_py_ff_effect_type);
+    if (pyeffect == NULL) {
+        return NULL;
+    }
+    pyeffect->owner  = NULL;
+    pyeffect->effect = *effect;
+    pyeffect->data   = (char*)&pyeffect->effect;
+    pyeffect->table  = &vjoy_ff_effect;
+    return (PyObject*)pyeffect;
+}
+
 #define VJOY_PY_CONST(m,v) assert(PyObject_SetAttrString(m, #v, \
                             PyLong_FromLong(v)) >= 0)
 
+// Create the vjoy module in the current interpreter
 void vjoy_py_initialize() {
     PyObject *module = Py_InitModule("vjoy", vjoy_py_module_methods);
 
     // Import C constants into module
+    assert(vjoy_py_ff_initialize() == 0);
+    Py_INCREF(&vjoy_py_ff_effect_type);
+    assert(PyModule_AddObject(module, "FeedbackEffect", (PyObject*)&vjoy_py_ff_effect_type) >= 0);
+    Py_INCREF(&vjoy_py_ff_struct_type);
+    assert(PyModule_AddObject(module, "FeedbackStruct", (PyObject*)&vjoy_py_ff_struct_type) >= 0);
+    assert(PyType_Ready(&vjoy_py_wake_type) == 0);
+    Py_INCREF(&vjoy_py_wake_type);
+    assert(PyModule_AddObject(module, "Wake", (PyObject*)&vjoy_py_wake_type) >= 0);
+
+    // struct module format of the packed records doVJoyThink() may return
+    assert(PyModule_AddStringConstant(module, "EVENT_FORMAT", "=HHi") >= 0);
+
     VJOY_PY_CONST(module, EV_SYN);
     VJOY_PY_CONST(module, EV_KEY);
     VJOY_PY_CONST(module, EV_REL);
@@ -3,6 +3,20 @@
 
 #include "vjoy.h"
 
-void vjoy_py_initialize();
+// What a doVJoyThink() generator yields to be resumed off the tick
+typedef struct _vjoy_py_wake {
+    PyObject_HEAD
+    double deadline; // Seconds on CLOCK_MONOTONIC, negative for none
+    int    fd;       // Descriptor to wait for, -1 for none
+} vjoy_py_wake;
+
+extern PyTypeObject vjoy_py_wake_type;
+
+void           vjoy_py_initialize();
+PyThreadState *vjoy_py_new_interpreter(const char *path);
+void           vjoy_py_enter(vjoy_dev *dev);
+void           vjoy_py_leave(vjoy_dev *dev);
+void           vjoy_py_log_error();
+PyObject      *vjoy_convert_ff_effect(struct ff_effect *effect);
 
 #endif /* _VJOY_PYTHON_H */
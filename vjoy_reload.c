@@ -0,0 +1,101 @@
+#include "vjoy.h"
+#include "vjoy_reload.h"
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/inotify.h>
+
+/* Hot reload.  This thread watches the module directory and, once a
+ * changed module has been quiet for VJOY_RELOAD_SETTLE_MS, imports it
+ * into a fresh interpreter with vjoy_reload_module().  Devices keep their
+ * uinput descriptors unless their capabilities changed.
+ */
+
+static pthread_t vjoy_reload_thread;
+static int       vjoy_reload_fd = -1;
+
+// Module name of a changed file, or NULL for anything but foo.py
+static const char *vjoy_reload_name(const struct inotify_event *ev, char *name) {
+    size_t len = ev->len > 0 ? strlen(ev->name) : 0;
+    // Editors drop hidden lock and backup files next to the module
+    if (len <= 3 || ev->name[0] == '.' || strcmp(ev->name + len - 3, ".py") != 0) {
+        return NULL;
+    }
+    memcpy(name, ev->name, len - 3);
+    name[len - 3] = '\0';
+    return name;
+}
+
+static void *vjoy_reload_loop(void *arg) {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    char names[VJOY_RELOAD_MAX][NAME_MAX + 1];
+    int  count = 0;
+    while (1) {
+        struct pollfd pfd = {vjoy_reload_fd, POLLIN, 0};
+        int           n   = poll(&pfd, 1, count > 0 ? VJOY_RELOAD_SETTLE_MS : -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            vjoy_log(VJOY_LOG_ERROR, "Error waiting for module changes: %s", strerror(errno));
+            return NULL;
+        }
+        // Settled: editors often write a file more than once per save
+        if (n == 0) {
+            for (int i=0; i<count; i++) {
+                if (vjoy_reload_module(names[i]) == 0) {
+                    vjoy_log(VJOY_LOG_DEBUG, "Module %s changed, but no device runs it.", names[i]);
+                }
+            }
+            count = 0;
+            continue;
+        }
+        ssize_t len = read(vjoy_reload_fd, buf, sizeof(buf));
+        if (len < 0) {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            vjoy_log(VJOY_LOG_ERROR, "Error reading module changes: %s", strerror(errno));
+            return NULL;
+        }
+        for (char *p = buf; p < buf + len; ) {
+            struct inotify_event *ev = (struct inotify_event*)p;
+            char                  name[NAME_MAX + 1];
+            p += sizeof(struct inotify_event) + ev->len;
+            if (vjoy_reload_name(ev, name) == NULL) {
+                continue;
+            }
+            int seen = 0;
+            for (int i=0; i<count && !seen; i++) {
+                seen = strcmp(names[i], name) == 0;
+            }
+            if (!seen && count < VJOY_RELOAD_MAX) {
+                strcpy(names[count++], name);
+            }
+        }
+    }
+}
+
+int vjoy_reload_start(const char *dir) {
+    vjoy_reload_fd = inotify_init1(IN_CLOEXEC);
+    if (vjoy_reload_fd < 0) {
+        vjoy_log(VJOY_LOG_WARN, "Hot reload unavailable: %s", strerror(errno));
+        return -1;
+    }
+    // Saves land either in place or as a rename over the old file
+    if (inotify_add_watch(vjoy_reload_fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        vjoy_log(VJOY_LOG_WARN, "Not watching %s for module changes: %s", dir, strerror(errno));
+        close(vjoy_reload_fd);
+        vjoy_reload_fd = -1;
+        return -1;
+    }
+    /* Python 2 only notices a stale .pyc by its source mtime in whole
+     * seconds, so two saves within a second would reload the old code.
+     */
+    Py_DontWriteBytecodeFlag = 1;
+    if (pthread_create(&vjoy_reload_thread, NULL, vjoy_reload_loop, NULL) != 0) {
+        vjoy_log(VJOY_LOG_ERROR, "Failed to start reload thread.");
+        return -1;
+    }
+    vjoy_log(VJOY_LOG_INFO, "Reloading modules in %s when they change.", dir);
+    return 0;
+}
@@ -0,0 +1,25 @@
+#ifndef _VJOY_RELOAD_H
+#define _VJOY_RELOAD_H
+
+#define VJOY_RELOAD_SETTLE_MS 100 // Quiet time after a module changes before it is reloaded
+#define VJOY_RELOAD_MAX       64  // Distinct modules collected per settle period
+
+/* A freshly imported module waiting to replace a group's.  Built by the
+ * reload thread and handed over through vjoy_dev.reload; the group's
+ * reactor swaps it in between two ticks.
+ */
+typedef struct _vjoy_reload {
+    PyThreadState  *pystate;
+    PyObject       *pymodule;
+    int             hasthink;
+    vjoy_event_sink eventsink;
+    int             membercount;
+    vjoy_info       info[VJOY_GROUP_MAX];      // Parsed getVJoyInfo(), one per group device
+    vjoy_transform  transform[VJOY_GROUP_MAX];
+} vjoy_reload;
+
+int  vjoy_reload_start(const char *dir);
+int  vjoy_reload_module(const char *name);
+void vjoy_reload_discard(vjoy_reload *reload);
+
+#endif /* _VJOY_RELOAD_H */
@@ -0,0 +1,118 @@
+#include "vjoy.h"
+#include "vjoy_shm.h"
+#include <errno.h>
+
+/* Shared-memory input channel, vjoy's side.  Regions are created with the
+ * device and drained on its reactor whenever the group submits a frame,
+ * without entering Python.
+ */
+
+#define VJOY_SHM_RETRIES 16 // Torn state reads retried before giving up for a tick
+
+_Static_assert(VJOY_SHM_ABS == ABS_CNT, "vjoy_shm.h is out of date");
+_Static_assert(VJOY_SHM_KEYS == KEY_CNT, "vjoy_shm.h is out of date");
+
+int vjoy_shm_create(vjoy_dev *dev) {
+    // A region left behind by a crashed vjoy would carry stale state
+    shm_unlink(dev->devinfo.shmname);
+    int fd = shm_open(dev->devinfo.shmname, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0 || ftruncate(fd, sizeof(vjoy_shm)) < 0) {
+        vjoy_log(VJOY_LOG_ERROR, "Failed to create shared memory %s: %s", dev->devinfo.shmname, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+            shm_unlink(dev->devinfo.shmname);
+        }
+        return -1;
+    }
+    void *map = mmap(NULL, sizeof(vjoy_shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        vjoy_log(VJOY_LOG_ERROR, "Failed to map shared memory %s: %s", dev->devinfo.shmname, strerror(errno));
+        shm_unlink(dev->devinfo.shmname);
+        return -1;
+    }
+    dev->shm = map;
+    dev->shm->version = VJOY_SHM_VERSION;
+    dev->shm->size    = sizeof(vjoy_shm);
+    // Producers check the magic last, the rest is zero from ftruncate()
+    __atomic_store_n(&dev->shm->magic, VJOY_SHM_MAGIC, __ATOMIC_RELEASE);
+    vjoy_log(VJOY_LOG_INFO, "\tShared memory input on %s", dev->devinfo.shmname);
+    return 0;
+}
+
+// Stage whatever producers wrote since the last call
+void vjoy_shm_consume(vjoy_dev *dev) {
+    vjoy_shm *shm = dev->shm;
+    uint64_t  absvalid, keyvalid[VJOY_SHM_KEYWORDS], keys[VJOY_SHM_KEYWORDS];
+    int32_t   abs[VJOY_SHM_ABS];
+    int       consistent = 0;
+
+    for (int retry=0; retry<VJOY_SHM_RETRIES && !consistent; retry++) {
+        uint32_t seq = __atomic_load_n(&shm->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) {
+            continue;
+        }
+        absvalid = __atomic_load_n(&shm->absvalid, __ATOMIC_RELAXED);
+        for (int i=0; i<VJOY_SHM_KEYWORDS; i++) {
+            keyvalid[i] = __atomic_load_n(&shm->keyvalid[i], __ATOMIC_RELAXED);
+            keys[i]     = __atomic_load_n(&shm->keys[i], __ATOMIC_RELAXED);
+        }
+        for (int i=0; i<dev->devinfo.absaxiscount; i++) {
+            int code  = dev->devinfo.absaxis[i];
+            abs[code] = __atomic_load_n(&shm->abs[code], __ATOMIC_RELAXED);
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        consistent = __atomic_load_n(&shm->seq, __ATOMIC_RELAXED) == seq;
+    }
+    // Only declared codes are looked at; vjoy_dev_emit() drops the unchanged ones
+    if (consistent) {
+        for (int i=0; i<dev->devinfo.absaxiscount; i++) {
+            int code = dev->devinfo.absaxis[i];
+            if (absvalid & (1ULL << code)) {
+                vjoy_dev_emit(dev, EV_ABS, code, abs[code]);
+            }
+        }
+        for (int i=0; i<dev->devinfo.buttoncount; i++) {
+            int      code = dev->devinfo.buttons[i];
+            uint64_t bit  = 1ULL << (code % 64);
+            if (keyvalid[code / 64] & bit) {
+                vjoy_dev_emit(dev, EV_KEY, code, (keys[code / 64] & bit) != 0);
+            }
+        }
+    }
+
+    uint32_t tail = shm->tail;
+    uint32_t head = __atomic_load_n(&shm->head, __ATOMIC_ACQUIRE);
+    if (head == tail) {
+        return;
+    }
+    // A producer never gets more than a ring ahead, anything else is garbage
+    if (head - tail > VJOY_SHM_RING) {
+        static vjoy_log_limit ringerr;
+        vjoy_log_limited(&ringerr, VJOY_LOG_ERROR, "Shared memory ring of device %i is corrupt, dropping it.", dev->id);
+        __atomic_store_n(&shm->tail, head, __ATOMIC_RELEASE);
+        return;
+    }
+    for (uint32_t i=tail; i!=head; i++) {
+        vjoy_shm_event evt = shm->ring[i & (VJOY_SHM_RING - 1)];
+        vjoy_dev_emit(dev, evt.type, evt.code, evt.value);
+    }
+    __atomic_store_n(&shm->tail, head, __ATOMIC_RELEASE);
+    vjoy_stat_add(&dev->stats.shmevents, head - tail);
+}
+
+void vjoy_shm_destroy(vjoy_dev *dev) {
+    if (dev->shm == NULL) {
+        return;
+    }
+    munmap(dev->shm, sizeof(vjoy_shm));
+    shm_unlink(dev->devinfo.shmname);
+    dev->shm = NULL;
+}
+
+// Remove the name only; reactors may still be reading the mapping
+void vjoy_shm_unlink(vjoy_dev *dev) {
+    if (dev->shm != NULL) {
+        shm_unlink(dev->devinfo.shmname);
+    }
+}
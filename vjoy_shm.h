@@ -0,0 +1,145 @@
+#ifndef _VJOY_SHM_H
+#define _VJOY_SHM_H
+
+/* Shared-memory input channel.  A device whose getVJoyInfo() sets 'shm'
+ * gets a POSIX shared memory region (/vjoy-<uid>-<id> unless named) that
+ * any process can feed without Python or syscalls on its side:
+ *
+ *   vjoy_shm *shm = vjoy_shm_open(id);
+ *   vjoy_shm_begin(shm);
+ *   vjoy_shm_set_axis(shm, ABS_X, x);
+ *   vjoy_shm_set_key(shm, BTN_A, 1);
+ *   vjoy_shm_end(shm);
+ *   vjoy_shm_push(shm, EV_REL, REL_WHEEL, 1);
+ *
+ * The state block holds the latest absolute axes and keys behind a
+ * seqlock; vjoy samples it every tick and only sends what changed.  The
+ * ring carries events that must not be coalesced (relative motion, key
+ * taps between two ticks, SYN_REPORTs splitting frames).  There must be
+ * one producer per region.  This header is all a producer needs; link
+ * with -lrt on older C libraries.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define VJOY_SHM_MAGIC    0x4d48534a594f4a56ULL // "VJOYJSHM"
+#define VJOY_SHM_VERSION  1
+#define VJOY_SHM_ABS      64  // ABS_CNT
+#define VJOY_SHM_KEYS     768 // KEY_CNT
+#define VJOY_SHM_KEYWORDS (VJOY_SHM_KEYS / 64)
+#define VJOY_SHM_RING     4096 // Ring entries, a power of two
+
+typedef struct _vjoy_shm_event {
+    uint16_t type;
+    uint16_t code;
+    int32_t  value;
+} vjoy_shm_event;
+
+typedef struct _vjoy_shm {
+    uint64_t       magic;    // VJOY_SHM_MAGIC once the region is initialized
+    uint32_t       version;  // VJOY_SHM_VERSION
+    uint32_t       size;     // sizeof(vjoy_shm) of the creator
+
+    // State block, written between vjoy_shm_begin() and vjoy_shm_end()
+    uint32_t       seq __attribute__((aligned(64))); // Odd while being written
+    uint32_t       reserved;
+    uint64_t       absvalid;                    // Axes the producer has set
+    uint64_t       keyvalid[VJOY_SHM_KEYWORDS]; // Keys the producer has set
+    uint64_t       keys[VJOY_SHM_KEYWORDS];     // Pressed keys
+    int32_t        abs[VJOY_SHM_ABS];
+
+    // Event ring, free running indices, head written by the producer only
+    uint32_t       head __attribute__((aligned(64)));
+    uint32_t       tail __attribute__((aligned(64))); // Written by vjoy only
+    vjoy_shm_event ring[VJOY_SHM_RING] __attribute__((aligned(64)));
+} vjoy_shm;
+
+static inline void vjoy_shm_name(char *buf, size_t size, int id) {
+    snprintf(buf, size, "/vjoy-%i-%i", (int)getuid(), id);
+}
+
+// Map a region by its shm_open() name, NULL if it is missing or incompatible
+static inline vjoy_shm *vjoy_shm_open_name(const char *name) {
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    void *map = mmap(NULL, sizeof(vjoy_shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+    vjoy_shm *shm = (vjoy_shm*)map;
+    if (__atomic_load_n(&shm->magic, __ATOMIC_ACQUIRE) != VJOY_SHM_MAGIC ||
+        shm->version != VJOY_SHM_VERSION || shm->size != sizeof(vjoy_shm)) {
+        munmap(map, sizeof(vjoy_shm));
+        return NULL;
+    }
+    return shm;
+}
+
+// Map the default region of device id (its VJoyID)
+static inline vjoy_shm *vjoy_shm_open(int id) {
+    char name[64];
+    vjoy_shm_name(name, sizeof(name), id);
+    return vjoy_shm_open_name(name);
+}
+
+static inline void vjoy_shm_close(vjoy_shm *shm) {
+    munmap(shm, sizeof(vjoy_shm));
+}
+
+static inline void vjoy_shm_begin(vjoy_shm *shm) {
+    __atomic_store_n(&shm->seq, shm->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void vjoy_shm_set_axis(vjoy_shm *shm, int code, int32_t value) {
+    if (code >= 0 && code < VJOY_SHM_ABS) {
+        __atomic_store_n(&shm->abs[code], value, __ATOMIC_RELAXED);
+        __atomic_store_n(&shm->absvalid, shm->absvalid | (1ULL << code), __ATOMIC_RELAXED);
+    }
+}
+
+static inline void vjoy_shm_set_key(vjoy_shm *shm, int code, int pressed) {
+    if (code >= 0 && code < VJOY_SHM_KEYS) {
+        uint64_t bit  = 1ULL << (code % 64);
+        uint64_t keys = shm->keys[code / 64];
+        __atomic_store_n(&shm->keys[code / 64], pressed ? keys | bit : keys & ~bit, __ATOMIC_RELAXED);
+        __atomic_store_n(&shm->keyvalid[code / 64], shm->keyvalid[code / 64] | bit, __ATOMIC_RELAXED);
+    }
+}
+
+static inline void vjoy_shm_end(vjoy_shm *shm) {
+    __atomic_store_n(&shm->seq, shm->seq + 1, __ATOMIC_RELEASE);
+}
+
+// Queue one event, -1 if vjoy has fallen a whole ring behind
+static inline int vjoy_shm_push(vjoy_shm *shm, int type, int code, int32_t value) {
+    uint32_t head = shm->head;
+    if (head - __atomic_load_n(&shm->tail, __ATOMIC_ACQUIRE) >= VJOY_SHM_RING) {
+        return -1;
+    }
+    vjoy_shm_event *evt = &shm->ring[head & (VJOY_SHM_RING - 1)];
+    evt->type  = type;
+    evt->code  = code;
+    evt->value = value;
+    __atomic_store_n(&shm->head, head + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+#ifdef _VJOY_H
+// vjoy's side, see vjoy_shm.c
+int  vjoy_shm_create(vjoy_dev *dev);
+void vjoy_shm_consume(vjoy_dev *dev);
+void vjoy_shm_destroy(vjoy_dev *dev);
+void vjoy_shm_unlink(vjoy_dev *dev);
+#endif
+
+#endif /* _VJOY_SHM_H */
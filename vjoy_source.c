@@ -0,0 +1,487 @@
+#include "vjoy.h"
+#include "vjoy_source.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+
+/* Physical evdev devices read natively.  Every source has a remap table
+ * indexed by its own codes; each read() is translated through it straight
+ * into the target device's frame, so remapping a real joystick costs one
+ * read and one write and never enters Python unless the module subscribed
+ * to an event.
+ */
+
+// Codes a source can remap, keys then absolute then relative axes
+#define VJOY_SOURCE_CODES (KEY_CNT + ABS_CNT + REL_CNT)
+
+typedef struct _vjoy_source {
+    int           fd;
+    int           dropped;                     // SYN_DROPPED seen, skipping to the next SYN_REPORT
+    char          path[128];
+    struct input_event buf[VJOY_READ_BATCH];   // Last read(), consumed up to pos
+    int           pos;
+    int           len;
+    vjoy_evcode   map[VJOY_SOURCE_CODES];      // Target of each source code, type 0 when dropped
+    unsigned long subs[VJOY_NLONGS(VJOY_SOURCE_CODES)]; // Codes passed to doVJoySourceEvent()
+    float         absscale[ABS_CNT];           // Source range -> target range for ABS -> ABS
+    float         absoffset[ABS_CNT];
+    int           absthreshold[ABS_CNT];       // ABS -> KEY presses above it, the middle of the range
+    int           ffid[FF_MAX_EFFECTS];        // Physical id of each virtual effect id, -1 if none
+    float         ffscale[VJOY_FF_TYPES];
+} vjoy_source;
+
+static int vjoy_source_index(int type, int code) {
+    switch (type) {
+        case EV_KEY: return code >= 0 && code < KEY_CNT ? code : -1;
+        case EV_ABS: return code >= 0 && code < ABS_CNT ? KEY_CNT + code : -1;
+        case EV_REL: return code >= 0 && code < REL_CNT ? KEY_CNT + ABS_CNT + code : -1;
+        default:     return -1;
+    }
+}
+
+// A sequence of exactly count ints, e.g. one [type, code] entry
+static int vjoy_source_ints(PyObject *pyitem, int *out, int count) {
+    if (pyitem == NULL || !PySequence_Check(pyitem) || PySequence_Size(pyitem) != count) {
+        PyErr_Clear();
+        return -1;
+    }
+    for (int i=0; i<count; i++) {
+        PyObject *pyint = PySequence_GetItem(pyitem, i);
+        out[i] = pyint != NULL ? PyInt_AsLong(pyint) : -1;
+        Py_XDECREF(pyint);
+    }
+    if (PyErr_Occurred() != NULL) {
+        PyErr_Clear();
+        return -1;
+    }
+    return 0;
+}
+
+// Optional flag of a source entry, def when absent
+static int vjoy_source_flag(PyObject *entry, char *key, int def) {
+    PyObject *item = PyMapping_GetItemString(entry, key);
+    if (item == NULL) {
+        PyErr_Clear();
+        return def;
+    }
+    int value = PyObject_IsTrue(item);
+    Py_DECREF(item);
+    PyErr_Clear();
+    return value > 0;
+}
+
+static void vjoy_source_parse_map(vjoy_source_info *src, PyObject *pymap) {
+    int count = PySequence_Size(pymap);
+    for (int i=0; i<count; i++) {
+        PyObject *pyentry = PySequence_GetItem(pymap, i);
+        int       e[4];
+        if (vjoy_source_ints(pyentry, e, 4) < 0 ||
+            vjoy_source_index(e[0], e[1]) < 0 || vjoy_source_index(e[2], e[3]) < 0) {
+            vjoy_log(VJOY_LOG_WARN, "Ignoring map entry %i, expected [type, code, type, code] of keys or axes.", i);
+        } else if (e[0] != e[2] && (e[0] == EV_REL || e[2] == EV_REL)) {
+            vjoy_log(VJOY_LOG_WARN, "Ignoring map entry %i, relative axes only map to relative axes.", i);
+        } else if (src->mapcount >= VJOY_REMAP_MAX) {
+            vjoy_log(VJOY_LOG_WARN, "Ignoring map entry %i, at most %i are supported.", i, VJOY_REMAP_MAX);
+        } else {
+            src->from[src->mapcount] = (vjoy_evcode){e[0], e[1]};
+            src->to[src->mapcount]   = (vjoy_evcode){e[2], e[3]};
+            src->mapcount++;
+        }
+        Py_XDECREF(pyentry);
+    }
+    PyErr_Clear();
+}
+
+static void vjoy_source_parse_subscribe(vjoy_source_info *src, PyObject *pysubs) {
+    int count = PySequence_Size(pysubs);
+    for (int i=0; i<count; i++) {
+        PyObject *pyentry = PySequence_GetItem(pysubs, i);
+        int       e[2];
+        if (vjoy_source_ints(pyentry, e, 2) < 0 || vjoy_source_index(e[0], e[1]) < 0) {
+            vjoy_log(VJOY_LOG_WARN, "Ignoring subscription %i, expected [type, code] of a key or axis.", i);
+        } else if (src->subcount >= VJOY_REMAP_MAX) {
+            vjoy_log(VJOY_LOG_WARN, "Ignoring subscription %i, at most %i are supported.", i, VJOY_REMAP_MAX);
+        } else {
+            src->subscribe[src->subcount++] = (vjoy_evcode){e[0], e[1]};
+        }
+        Py_XDECREF(pyentry);
+    }
+    PyErr_Clear();
+}
+
+// 'ffscale': one factor for every effect, or a dict of them by FF_* type
+static void vjoy_source_parse_ffscale(vjoy_source_info *src, PyObject *pyscale) {
+    if (PyMapping_Check(pyscale)) {
+        for (int type=FF_EFFECT_MIN; type<=FF_EFFECT_MAX; type++) {
+            PyObject *pykey    = PyInt_FromLong(type);
+            PyObject *pyfactor = pykey != NULL ? PyObject_GetItem(pyscale, pykey) : NULL;
+            if (pyfactor != NULL) {
+                src->ffscale[type - FF_EFFECT_MIN] = PyFloat_AsDouble(pyfactor);
+            }
+            Py_XDECREF(pyfactor);
+            Py_XDECREF(pykey);
+            PyErr_Clear();
+        }
+    } else {
+        double factor = PyFloat_AsDouble(pyscale);
+        if (PyErr_Occurred() != NULL) {
+            vjoy_log(VJOY_LOG_WARN, "'ffscale' must be a number or a dict of them by effect type.");
+            factor = 1;
+        }
+        for (int t=0; t<VJOY_FF_TYPES; t++) {
+            src->ffscale[t] = factor;
+        }
+    }
+    PyErr_Clear();
+}
+
+/* Read the 'sources' list of getVJoyInfo(), dicts with a 'path' and
+ * optional 'grab', 'device', 'passthrough', 'map', 'subscribe',
+ * 'ffforward' and 'ffscale'.
+ */
+void vjoy_source_parse(vjoy_info *info, PyObject *pysources) {
+    int count = PySequence_Size(pysources);
+    if (count < 0) {
+        PyErr_Clear();
+        vjoy_log(VJOY_LOG_WARN, "'sources' must be a list of dicts.");
+        return;
+    }
+    for (int i=0; i<count; i++) {
+        PyObject *entry = PySequence_GetItem(pysources, i);
+        PyObject *pypath = entry != NULL && PyMapping_Check(entry) ? PyMapping_GetItemString(entry, "path") : NULL;
+        char     *path   = pypath != NULL ? PyString_AsString(pypath) : NULL;
+        PyErr_Clear();
+        if (path == NULL || strlen(path) >= sizeof(info->sources[0].path)) {
+            vjoy_log(VJOY_LOG_WARN, "Ignoring source %i, it needs a 'path' to an evdev device.", i);
+        } else if (info->sourcecount >= VJOY_SOURCE_MAX) {
+            vjoy_log(VJOY_LOG_WARN, "Ignoring source %i, at most %i are supported.", i, VJOY_SOURCE_MAX);
+        } else {
+            vjoy_source_info *src = &info->sources[info->sourcecount++];
+            memset(src, 0, sizeof(vjoy_source_info));
+            strcpy(src->path, path);
+            src->grab        = vjoy_source_flag(entry, "grab", 0);
+            src->passthrough = vjoy_source_flag(entry, "passthrough", 1);
+            PyObject *pydevice = PyMapping_GetItemString(entry, "device");
+            src->device = pydevice != NULL ? PyInt_AsLong(pydevice) : 0;
+            Py_XDECREF(pydevice);
+            PyErr_Clear();
+            PyObject *pymap = PyMapping_GetItemString(entry, "map");
+            if (pymap != NULL) {
+                vjoy_source_parse_map(src, pymap);
+                Py_DECREF(pymap);
+            }
+            PyObject *pysubs = PyMapping_GetItemString(entry, "subscribe");
+            if (pysubs != NULL) {
+                vjoy_source_parse_subscribe(src, pysubs);
+                Py_DECREF(pysubs);
+            }
+            PyErr_Clear();
+            src->ffforward = vjoy_source_flag(entry, "ffforward", 0);
+            for (int t=0; t<VJOY_FF_TYPES; t++) {
+                src->ffscale[t] = 1;
+            }
+            PyObject *pyscale = PyMapping_GetItemString(entry, "ffscale");
+            if (pyscale != NULL) {
+                vjoy_source_parse_ffscale(src, pyscale);
+                Py_DECREF(pyscale);
+            }
+            PyErr_Clear();
+        }
+        Py_XDECREF(pypath);
+        Py_XDECREF(entry);
+    }
+}
+
+// Map every code both devices declare onto itself
+static void vjoy_source_passthrough(vjoy_source *src, const vjoy_info *target) {
+    unsigned long bits[VJOY_NLONGS(KEY_CNT)];
+    struct { int type; const int *codes; int count; } kinds[] = {
+        {EV_KEY, target->buttons, target->buttoncount},
+        {EV_ABS, target->absaxis, target->absaxiscount},
+        {EV_REL, target->relaxis, target->relaxiscount},
+    };
+    for (int k=0; k<3; k++) {
+        memset(bits, 0, sizeof(bits));
+        if (ioctl(src->fd, EVIOCGBIT(kinds[k].type, sizeof(bits)), bits) < 0) {
+            continue;
+        }
+        for (int i=0; i<kinds[k].count; i++) {
+            int code = kinds[k].codes[i];
+            int idx  = vjoy_source_index(kinds[k].type, code);
+            if (idx >= 0 && (bits[code / VJOY_LONG_BITS] & (1UL << (code % VJOY_LONG_BITS)))) {
+                src->map[idx] = (vjoy_evcode){kinds[k].type, code};
+            }
+        }
+    }
+}
+
+static void vjoy_source_emit(vjoy_source *src, vjoy_dev *target, int idx, int type, int value) {
+    vjoy_evcode to = src->map[idx];
+    if (to.type == 0) {
+        return;
+    }
+    // Absolute axes are rescaled between ranges, keys and axes converted, anything else goes as is
+    if (type == EV_ABS && to.type == EV_ABS) {
+        value = lrintf(value * src->absscale[idx - KEY_CNT] + src->absoffset[idx - KEY_CNT]);
+    } else if (type == EV_ABS && to.type == EV_KEY) {
+        value = value > src->absthreshold[idx - KEY_CNT];
+    } else if (type == EV_KEY && to.type == EV_ABS) {
+        const struct input_absinfo *out = &target->devinfo.absinfo[to.code];
+        value = value ? out->maximum : out->minimum;
+    }
+    vjoy_dev_emit(target, to.type, to.code, value);
+}
+
+/* Stage the source's current key and axis state, after opening it or when
+ * the kernel dropped events, so the target never keeps a stale value.
+ */
+static void vjoy_source_sync(vjoy_source *src, vjoy_dev *target) {
+    unsigned long keys[VJOY_NLONGS(KEY_CNT)];
+    memset(keys, 0, sizeof(keys));
+    if (ioctl(src->fd, EVIOCGKEY(sizeof(keys)), keys) >= 0) {
+        for (int code=0; code<KEY_CNT; code++) {
+            if (src->map[code].type != 0 && src->map[code].type != EV_REL) {
+                vjoy_source_emit(src, target, code, EV_KEY,
+                                 (keys[code / VJOY_LONG_BITS] >> (code % VJOY_LONG_BITS)) & 1);
+            }
+        }
+    }
+    for (int code=0; code<ABS_CNT; code++) {
+        struct input_absinfo abs;
+        int                  idx = KEY_CNT + code;
+        if (src->map[idx].type != 0 && src->map[idx].type != EV_REL &&
+            ioctl(src->fd, EVIOCGABS(code), &abs) >= 0) {
+            vjoy_source_emit(src, target, idx, EV_ABS, abs.value);
+        }
+    }
+    vjoy_stat_add(&target->stats.syscalls, 1 + ABS_CNT);
+}
+
+// Open a source and compile its remap table against the device it feeds
+vjoy_source *vjoy_source_open(const vjoy_source_info *info, vjoy_dev *target) {
+    char name[256] = "";
+    // Forwarding feedback needs write access, for EVIOCSFF and playback
+    int  fd = open(info->path, (info->ffforward ? O_RDWR : O_RDONLY) | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        vjoy_log(VJOY_LOG_ERROR, "Failed to open source %s: %s", info->path, strerror(errno));
+        return NULL;
+    }
+    ioctl(fd, EVIOCGNAME(sizeof(name) - 1), name);
+    int grabbed = info->grab && ioctl(fd, EVIOCGRAB, 1) == 0;
+    if (info->grab && !grabbed) {
+        vjoy_log(VJOY_LOG_WARN, "Failed to grab source %s, sharing it: %s", info->path, strerror(errno));
+    }
+    vjoy_source *src = calloc(1, sizeof(vjoy_source));
+    src->fd = fd;
+    strcpy(src->path, info->path);
+    memset(src->ffid, -1, sizeof(src->ffid));
+    memcpy(src->ffscale, info->ffscale, sizeof(src->ffscale));
+    if (info->passthrough) {
+        vjoy_source_passthrough(src, &target->devinfo);
+    }
+    for (int i=0; i<info->mapcount; i++) {
+        src->map[vjoy_source_index(info->from[i].type, info->from[i].code)] = info->to[i];
+    }
+    for (int i=0; i<info->subcount; i++) {
+        int idx = vjoy_source_index(info->subscribe[i].type, info->subscribe[i].code);
+        src->subs[idx / VJOY_LONG_BITS] |= 1UL << (idx % VJOY_LONG_BITS);
+    }
+    for (int code=0; code<ABS_CNT; code++) {
+        vjoy_evcode          to = src->map[KEY_CNT + code];
+        struct input_absinfo abs;
+        src->absscale[code]     = 1.0f;
+        src->absoffset[code]    = 0.0f;
+        src->absthreshold[code] = 0;
+        if (to.type == EV_ABS && ioctl(fd, EVIOCGABS(code), &abs) >= 0 && abs.maximum > abs.minimum) {
+            const struct input_absinfo *out = &target->devinfo.absinfo[to.code];
+            src->absscale[code]  = (out->maximum - (double)out->minimum) / (abs.maximum - (double)abs.minimum);
+            src->absoffset[code] = out->minimum - abs.minimum * (double)src->absscale[code];
+        } else if (to.type == EV_KEY && ioctl(fd, EVIOCGABS(code), &abs) >= 0) {
+            src->absthreshold[code] = abs.minimum + (abs.maximum - (long long)abs.minimum) / 2;
+        }
+    }
+    vjoy_log(VJOY_LOG_INFO, "\tSource %s (%s)%s%s", info->path, name, grabbed ? ", grabbed" : "",
+             info->ffforward ? ", forwarding feedback" : "");
+    vjoy_source_sync(src, target);
+    return src;
+}
+
+int vjoy_source_fd(vjoy_source *src) {
+    return src->fd;
+}
+
+/* Remap the source's events into target's frame, reading more once the
+ * last read() is used up.  Subscribed events are copied to subs, which has
+ * room for VJOY_READ_BATCH, and stop remapping before the SYN_REPORT ending
+ * their frame so the module's response lands in the same frame.  Returns 1
+ * to be called again, 0 once drained or -1 if the device went away.
+ */
+int vjoy_source_read(vjoy_source *src, vjoy_dev *target, vjoy_packed_event *subs, int *subcount) {
+    *subcount = 0;
+    if (src->pos == src->len) {
+        ssize_t s;
+        do {
+            s = read(src->fd, src->buf, sizeof(src->buf));
+        } while (s < 0 && errno == EINTR);
+        vjoy_stat_add(&target->stats.syscalls, 1);
+        if (s < 0 && errno == EAGAIN) {
+            return 0;
+        }
+        if (s <= 0) {
+            vjoy_log(VJOY_LOG_WARN, "Source %s is gone: %s", src->path, s < 0 ? strerror(errno) : "end of file");
+            return -1;
+        }
+        src->pos = 0;
+        src->len = s / sizeof(struct input_event);
+        vjoy_stat_add(&target->stats.sourceevents, src->len);
+    }
+    while (src->pos < src->len) {
+        struct input_event *evt = &src->buf[src->pos];
+        if (evt->type == EV_SYN && evt->code == SYN_REPORT && *subcount > 0) {
+            return 1;
+        }
+        src->pos++;
+        if (evt->type == EV_SYN) {
+            // After a SYN_DROPPED the kernel's queue overflowed, so re-read
+            // the whole state at the end of the incomplete frame
+            if (evt->code == SYN_DROPPED) {
+                src->dropped = 1;
+            } else if (evt->code == SYN_REPORT) {
+                if (src->dropped) {
+                    src->dropped = 0;
+                    vjoy_source_sync(src, target);
+                }
+                vjoy_dev_emit(target, EV_SYN, SYN_REPORT, 0);
+            }
+            continue;
+        }
+        int idx = vjoy_source_index(evt->type, evt->code);
+        if (idx < 0 || src->dropped) {
+            continue;
+        }
+        vjoy_source_emit(src, target, idx, evt->type, evt->value);
+        if (src->subs[idx / VJOY_LONG_BITS] & (1UL << (idx % VJOY_LONG_BITS))) {
+            subs[*subcount].type  = evt->type;
+            subs[*subcount].code  = evt->code;
+            subs[*subcount].value = evt->value;
+            (*subcount)++;
+        }
+    }
+    // The watch is level-triggered, a short read means the queue is empty
+    return src->len == VJOY_READ_BATCH;
+}
+
+static int vjoy_source_scale16(int value, float scale, int lo, int hi) {
+    long scaled = lrintf(value * scale);
+    return scaled < lo ? lo : (scaled > hi ? hi : scaled);
+}
+
+static void vjoy_source_scale_envelope(struct ff_envelope *envelope, float scale) {
+    envelope->attack_level = vjoy_source_scale16(envelope->attack_level, scale, 0, USHRT_MAX);
+    envelope->fade_level   = vjoy_source_scale16(envelope->fade_level, scale, 0, USHRT_MAX);
+}
+
+// Scale an effect's strength, leaving its timing and shape alone
+static void vjoy_source_ff_scale(struct ff_effect *effect, float scale) {
+    switch (effect->type) {
+        case FF_RUMBLE:
+            effect->u.rumble.strong_magnitude = vjoy_source_scale16(effect->u.rumble.strong_magnitude, scale, 0, USHRT_MAX);
+            effect->u.rumble.weak_magnitude   = vjoy_source_scale16(effect->u.rumble.weak_magnitude, scale, 0, USHRT_MAX);
+            break;
+        case FF_CONSTANT:
+            effect->u.constant.level = vjoy_source_scale16(effect->u.constant.level, scale, SHRT_MIN, SHRT_MAX);
+            vjoy_source_scale_envelope(&effect->u.constant.envelope, scale);
+            break;
+        case FF_PERIODIC:
+            effect->u.periodic.magnitude = vjoy_source_scale16(effect->u.periodic.magnitude, scale, SHRT_MIN, SHRT_MAX);
+            effect->u.periodic.offset    = vjoy_source_scale16(effect->u.periodic.offset, scale, SHRT_MIN, SHRT_MAX);
+            vjoy_source_scale_envelope(&effect->u.periodic.envelope, scale);
+            break;
+        case FF_RAMP:
+            effect->u.ramp.start_level = vjoy_source_scale16(effect->u.ramp.start_level, scale, SHRT_MIN, SHRT_MAX);
+            effect->u.ramp.end_level   = vjoy_source_scale16(effect->u.ramp.end_level, scale, SHRT_MIN, SHRT_MAX);
+            vjoy_source_scale_envelope(&effect->u.ramp.envelope, scale);
+            break;
+        case FF_SPRING:
+        case FF_FRICTION:
+        case FF_DAMPER:
+        case FF_INERTIA:
+            for (int i=0; i<2; i++) {
+                struct ff_condition_effect *c = &effect->u.condition[i];
+                c->right_saturation = vjoy_source_scale16(c->right_saturation, scale, 0, USHRT_MAX);
+                c->left_saturation  = vjoy_source_scale16(c->left_saturation, scale, 0, USHRT_MAX);
+                c->right_coeff      = vjoy_source_scale16(c->right_coeff, scale, SHRT_MIN, SHRT_MAX);
+                c->left_coeff       = vjoy_source_scale16(c->left_coeff, scale, SHRT_MIN, SHRT_MAX);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/* Relay an effect the game uploaded to the virtual device.  The physical
+ * device hands out its own ids; updates of a known effect reuse its id.
+ */
+void vjoy_source_ff_upload(vjoy_source *src, const struct ff_effect *effect) {
+    struct ff_effect copy = *effect;
+    if (effect->id < 0 || effect->id >= FF_MAX_EFFECTS ||
+        effect->type < FF_EFFECT_MIN || effect->type > FF_EFFECT_MAX) {
+        return;
+    }
+    // uinput does not carry custom waveform samples, there is nothing to send
+    if (effect->type == FF_PERIODIC && effect->u.periodic.waveform == FF_CUSTOM) {
+        static vjoy_log_limit customerr;
+        vjoy_log_limited(&customerr, VJOY_LOG_WARN, "Not forwarding custom waveform effect %i to %s.", effect->id, src->path);
+        return;
+    }
+    if (src->ffscale[effect->type - FF_EFFECT_MIN] != 1.0f) {
+        vjoy_source_ff_scale(&copy, src->ffscale[effect->type - FF_EFFECT_MIN]);
+    }
+    copy.id = src->ffid[effect->id];
+    if (ioctl(src->fd, EVIOCSFF, &copy) < 0) {
+        static vjoy_log_limit uploaderr;
+        vjoy_log_limited(&uploaderr, VJOY_LOG_WARN, "Failed to forward effect %i to %s: %s", effect->id, src->path, strerror(errno));
+        return;
+    }
+    src->ffid[effect->id] = copy.id;
+}
+
+void vjoy_source_ff_erase(vjoy_source *src, int id) {
+    if (id < 0 || id >= FF_MAX_EFFECTS || src->ffid[id] < 0) {
+        return;
+    }
+    ioctl(src->fd, EVIOCRMFF, src->ffid[id]);
+    src->ffid[id] = -1;
+}
+
+// Relay playback and gain/autocenter, translating effect ids
+void vjoy_source_ff_event(vjoy_source *src, int code, int value) {
+    struct input_event evt;
+    memset(&evt, 0, sizeof(struct input_event));
+    evt.type  = EV_FF;
+    evt.code  = code;
+    evt.value = value;
+    if (code < FF_MAX_EFFECTS) {
+        if (src->ffid[code] < 0) {
+            return;
+        }
+        evt.code = src->ffid[code];
+    } else if (code != FF_GAIN && code != FF_AUTOCENTER) {
+        return;
+    }
+    if (write(src->fd, &evt, sizeof(struct input_event)) != sizeof(struct input_event)) {
+        static vjoy_log_limit playerr;
+        vjoy_log_limited(&playerr, VJOY_LOG_WARN, "Failed to forward feedback playback to %s: %s", src->path, strerror(errno));
+    }
+}
+
+// Closing releases a grab as well, and erases every forwarded effect
+void vjoy_source_close(vjoy_source *src) {
+    if (src == NULL) {
+        return;
+    }
+    close(src->fd);
+    free(src);
+}
@@ -0,0 +1,49 @@
+#ifndef _VJOY_SOURCE_H
+#define _VJOY_SOURCE_H
+
+#include <linux/input.h>
+
+#define VJOY_SOURCE_MAX 4  // Physical devices read natively per module
+#define VJOY_REMAP_MAX  32 // Explicit 'map' and 'subscribe' entries per source
+#define VJOY_FF_TYPES   (FF_EFFECT_MAX - FF_EFFECT_MIN + 1)
+
+// A [type, code] pair of an evdev event
+typedef struct _vjoy_evcode {
+    __u16 type;
+    __u16 code;
+} vjoy_evcode;
+
+/* One entry of the 'sources' list of getVJoyInfo(): a physical evdev
+ * device whose events are remapped into one of the module's devices
+ * without going through Python.
+ */
+typedef struct _vjoy_source_info {
+    char        path[128];   // /dev/input/event* or a /dev/input/by-id/ link
+    int         grab;        // EVIOCGRAB it so only vjoy sees its events
+    int         device;      // Group index of the device it feeds
+    int         passthrough; // Forward codes both devices declare unchanged
+    int         mapcount;
+    vjoy_evcode from[VJOY_REMAP_MAX]; // Explicit remappings, from[i] -> to[i]
+    vjoy_evcode to[VJOY_REMAP_MAX];
+    int         subcount;
+    vjoy_evcode subscribe[VJOY_REMAP_MAX]; // Also passed to doVJoySourceEvent()
+    int         ffforward;   // Relay the device's force feedback to this one
+    float       ffscale[VJOY_FF_TYPES]; // Strength of forwarded effects per FF_* type
+} vjoy_source_info;
+
+struct _vjoy_dev;
+struct _vjoy_info;
+struct _vjoy_source;
+struct _vjoy_packed_event;
+
+void                 vjoy_source_parse(struct _vjoy_info *info, PyObject *pysources);
+struct _vjoy_source *vjoy_source_open(const vjoy_source_info *info, struct _vjoy_dev *target);
+int                  vjoy_source_fd(struct _vjoy_source *source);
+int                  vjoy_source_read(struct _vjoy_source *source, struct _vjoy_dev *target,
+                                      struct _vjoy_packed_event *subs, int *subcount);
+void                 vjoy_source_close(struct _vjoy_source *source);
+void                 vjoy_source_ff_upload(struct _vjoy_source *source, const struct ff_effect *effect);
+void                 vjoy_source_ff_erase(struct _vjoy_source *source, int id);
+void                 vjoy_source_ff_event(struct _vjoy_source *source, int code, int value);
+
+#endif /* _VJOY_SOURCE_H */
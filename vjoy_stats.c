@@ -0,0 +1,302 @@
+#include "vjoy.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/signalfd.h>
+
+/* Hot path metrics.  Reactors only ever bump their own devices' counters
+ * and histograms; this thread reads them without locking and renders them
+ * in the Prometheus text format, on SIGUSR1 to stderr and to anyone who
+ * connects to the stats socket.
+ */
+
+static const double vjoy_stats_quantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+static pthread_t          vjoy_stats_thread;
+static int                vjoy_stats_sigfd    = -1;
+static int                vjoy_stats_listenfd = -1;
+static unsigned long long vjoy_stats_started  = 0;
+static char               vjoy_stats_path[sizeof(((struct sockaddr_un*)0)->sun_path)];
+
+static int vjoy_hist_index(unsigned long long ns) {
+    if (ns < (1ULL << VJOY_HIST_SUB_BITS)) {
+        return ns;
+    }
+    int mag = 63 - __builtin_clzll(ns);
+    if (mag > VJOY_HIST_MAG_MAX) {
+        return VJOY_HIST_BUCKETS - 1;
+    }
+    int shift = mag - VJOY_HIST_SUB_BITS;
+    return ((shift + 1) << VJOY_HIST_SUB_BITS) + (ns >> shift) - (1 << VJOY_HIST_SUB_BITS);
+}
+
+// Largest value that lands in a bucket
+static unsigned long long vjoy_hist_value(int index) {
+    int group = index >> VJOY_HIST_SUB_BITS;
+    if (group == 0) {
+        return index;
+    }
+    int                shift = group - 1;
+    unsigned long long sub   = index & ((1 << VJOY_HIST_SUB_BITS) - 1);
+    return (((1ULL << VJOY_HIST_SUB_BITS) + sub + 1) << shift) - 1;
+}
+
+void vjoy_hist_record(vjoy_hist *hist, unsigned long long ns) {
+    vjoy_stat_add(&hist->buckets[vjoy_hist_index(ns)], 1);
+    vjoy_stat_add(&hist->count, 1);
+    __atomic_store_n(&hist->sum, __atomic_load_n(&hist->sum, __ATOMIC_RELAXED) + ns, __ATOMIC_RELAXED);
+    if (ns > __atomic_load_n(&hist->max, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&hist->max, ns, __ATOMIC_RELAXED);
+    }
+}
+
+static void vjoy_stats_labels(char *buf, size_t size, vjoy_dev *dev) {
+    // Device names come from modules, escape them for the label value
+    int n = snprintf(buf, size, "device=\"%i\",name=\"", dev->id);
+    for (const char *c=dev->devinfo.name; *c != '\0' && n < (int)size - 3; c++) {
+        if (*c == '"' || *c == '\\') {
+            buf[n++] = '\\';
+        }
+        buf[n++] = *c == '\n' ? ' ' : *c;
+    }
+    snprintf(buf + n, size - n, "\"");
+}
+
+typedef struct _vjoy_stats_counter {
+    const char *name;
+    const char *help;
+    size_t      offset; // Of an unsigned long in vjoy_dev
+} vjoy_stats_counter;
+
+#define VJOY_STATS_FIELD(name, field, help) {name, help, offsetof(vjoy_dev, field)}
+
+static const vjoy_stats_counter vjoy_stats_counters[] = {
+    VJOY_STATS_FIELD("vjoy_ticks_total",            stats.ticks,      "Input loop ticks run"),
+    VJOY_STATS_FIELD("vjoy_events_received_total",  stats.eventsin,   "Events read from uinput"),
+    VJOY_STATS_FIELD("vjoy_events_written_total",   stats.eventsout,  "Events written to uinput"),
+    VJOY_STATS_FIELD("vjoy_syscalls_total",         stats.syscalls,   "read, write and ioctl calls on the hot path"),
+    VJOY_STATS_FIELD("vjoy_ff_uploads_total",       stats.ffuploads,  "Force feedback uploads served"),
+    VJOY_STATS_FIELD("vjoy_ff_erasures_total",      stats.fferasures, "Force feedback erasures served"),
+    VJOY_STATS_FIELD("vjoy_fd_reads_total",         stats.reads,      "doVJoyRead calls for watched descriptors"),
+    VJOY_STATS_FIELD("vjoy_shm_events_total",       stats.shmevents,  "Events taken from the shared memory ring"),
+    VJOY_STATS_FIELD("vjoy_source_events_total",    stats.sourceevents, "Events read from physical sources"),
+    VJOY_STATS_FIELD("vjoy_write_calls_total",      writecount,       "write calls issued to uinput"),
+    VJOY_STATS_FIELD("vjoy_writes_saved_total",     writesaved,       "write calls avoided by coalescing frames"),
+    VJOY_STATS_FIELD("vjoy_events_suppressed_total", suppressed,      "Events dropped as unchanged or merged"),
+    VJOY_STATS_FIELD("vjoy_empty_frames_total",     emptyframes,      "SYN_REPORTs dropped for empty frames"),
+    VJOY_STATS_FIELD("vjoy_tick_overruns_total",    overruns,         "Ticks that found earlier deadlines missed"),
+    VJOY_STATS_FIELD("vjoy_ticks_missed_total",     missed,           "Tick deadlines missed"),
+};
+
+typedef struct _vjoy_stats_summary {
+    const char *name;
+    const char *help;
+    size_t      offset; // Of a vjoy_hist in vjoy_dev
+} vjoy_stats_summary;
+
+static const vjoy_stats_summary vjoy_stats_summaries[] = {
+    VJOY_STATS_FIELD("vjoy_think_seconds",     stats.think,    "Time spent in doVJoyThink and staging its frame"),
+    VJOY_STATS_FIELD("vjoy_gil_wait_seconds",  stats.gilwait,  "Time spent waiting for the interpreter lock"),
+    VJOY_STATS_FIELD("vjoy_ff_upload_seconds", stats.ffupload, "Force feedback upload requests, begin to end"),
+};
+
+// Smallest bucket value at or above the given fraction of samples
+unsigned long long vjoy_hist_quantile(vjoy_hist *hist, double quantile) {
+    unsigned long counts[VJOY_HIST_BUCKETS];
+    unsigned long total = 0, seen = 0;
+    for (int i=0; i<VJOY_HIST_BUCKETS; i++) {
+        counts[i] = __atomic_load_n(&hist->buckets[i], __ATOMIC_RELAXED);
+        total    += counts[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    // Buckets are reported by their upper bound, which may overshoot the max
+    unsigned long      rank = quantile * total;
+    unsigned long long max  = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+    int                i;
+    for (i=0; i<VJOY_HIST_BUCKETS - 1; i++) {
+        seen += counts[i];
+        if (seen > rank) break;
+    }
+    return vjoy_hist_value(i) < max ? vjoy_hist_value(i) : max;
+}
+
+static void vjoy_stats_hist(FILE *out, const char *name, const char *labels, vjoy_hist *hist) {
+    int nquantiles = sizeof(vjoy_stats_quantiles)/sizeof(double);
+    for (int q=0; q<nquantiles; q++) {
+        fprintf(out, "%s{%s,quantile=\"%g\"} %.9f\n", name, labels, vjoy_stats_quantiles[q],
+                vjoy_hist_quantile(hist, vjoy_stats_quantiles[q]) / 1e9);
+    }
+    fprintf(out, "%s{%s,quantile=\"1\"} %.9f\n", name, labels,
+            __atomic_load_n(&hist->max, __ATOMIC_RELAXED) / 1e9);
+    fprintf(out, "%s_sum{%s} %.9f\n", name, labels,
+            __atomic_load_n(&hist->sum, __ATOMIC_RELAXED) / 1e9);
+    fprintf(out, "%s_count{%s} %lu\n", name, labels,
+            __atomic_load_n(&hist->count, __ATOMIC_RELAXED));
+}
+
+// Render every device's metrics; the caller holds vjoy_devices_lock()
+void vjoy_stats_report(FILE *out) {
+    char labels[UINPUT_MAX_NAME_SIZE * 2 + 32];
+    fprintf(out, "# HELP vjoy_uptime_seconds Time since stats collection started\n");
+    fprintf(out, "# TYPE vjoy_uptime_seconds gauge\n");
+    fprintf(out, "vjoy_uptime_seconds %.3f\n", (vjoy_stats_now() - vjoy_stats_started) / 1e9);
+    int ncounters = sizeof(vjoy_stats_counters)/sizeof(vjoy_stats_counter);
+    for (int c=0; c<ncounters; c++) {
+        fprintf(out, "# HELP %s %s\n", vjoy_stats_counters[c].name, vjoy_stats_counters[c].help);
+        fprintf(out, "# TYPE %s counter\n", vjoy_stats_counters[c].name);
+        for (int id=0; id<VJOY_MAX_DEVICES; id++) {
+            vjoy_dev *dev = vjoy_get_device(id);
+            if (dev == NULL) continue;
+            unsigned long *counter = (unsigned long*)((char*)dev + vjoy_stats_counters[c].offset);
+            vjoy_stats_labels(labels, sizeof(labels), dev);
+            fprintf(out, "%s{%s} %lu\n", vjoy_stats_counters[c].name, labels,
+                    __atomic_load_n(counter, __ATOMIC_RELAXED));
+        }
+    }
+    int nsummaries = sizeof(vjoy_stats_summaries)/sizeof(vjoy_stats_summary);
+    for (int s=0; s<nsummaries; s++) {
+        fprintf(out, "# HELP %s %s\n", vjoy_stats_summaries[s].name, vjoy_stats_summaries[s].help);
+        fprintf(out, "# TYPE %s summary\n", vjoy_stats_summaries[s].name);
+        for (int id=0; id<VJOY_MAX_DEVICES; id++) {
+            vjoy_dev *dev = vjoy_get_device(id);
+            if (dev == NULL) continue;
+            vjoy_stats_labels(labels, sizeof(labels), dev);
+            vjoy_stats_hist(out, vjoy_stats_summaries[s].name, labels,
+                            (vjoy_hist*)((char*)dev + vjoy_stats_summaries[s].offset));
+        }
+    }
+}
+
+// Render the report into memory, so the device lock is never held across I/O
+static char *vjoy_stats_render(size_t *len) {
+    char *text = NULL;
+    FILE *out  = open_memstream(&text, len);
+    if (out == NULL) {
+        return NULL;
+    }
+    vjoy_devices_lock();
+    vjoy_stats_report(out);
+    vjoy_devices_unlock();
+    fclose(out);
+    return text;
+}
+
+static void vjoy_stats_serve(int fd) {
+    size_t  len  = 0;
+    char   *text = vjoy_stats_render(&len);
+    if (text == NULL) {
+        return;
+    }
+    for (size_t done=0; done<len; ) {
+        ssize_t s = send(fd, text + done, len - done, MSG_NOSIGNAL);
+        if (s < 0 && errno == EINTR) continue;
+        if (s <= 0) break;
+        done += s;
+    }
+    free(text);
+}
+
+static void *vjoy_stats_loop(void *arg) {
+    struct pollfd fds[2] = {
+        {vjoy_stats_sigfd,    POLLIN, 0},
+        {vjoy_stats_listenfd, POLLIN, 0}
+    };
+    while (1) {
+        if (poll(fds, vjoy_stats_listenfd >= 0 ? 2 : 1, -1) < 0) {
+            continue;
+        }
+        if (fds[0].revents & POLLIN) {
+            struct signalfd_siginfo info;
+            if (read(vjoy_stats_sigfd, &info, sizeof(info)) == sizeof(info)) {
+                // Keep queued log lines ahead of the report
+                vjoy_log_flush();
+                size_t  len  = 0;
+                char   *text = vjoy_stats_render(&len);
+                if (text != NULL) {
+                    fwrite(text, 1, len, stderr);
+                    fflush(stderr);
+                    free(text);
+                }
+            }
+        }
+        if (fds[1].revents & POLLIN) {
+            int client = accept4(vjoy_stats_listenfd, NULL, NULL, SOCK_CLOEXEC);
+            if (client >= 0) {
+                // A stalled reader must not hold up SIGUSR1 dumps for long
+                struct timeval timeout = {1, 0};
+                setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+                vjoy_stats_serve(client);
+                close(client);
+            }
+        }
+    }
+    return NULL;
+}
+
+static void vjoy_stats_unlink() {
+    unlink(vjoy_stats_path);
+}
+
+/* Must run before any other thread is started: SIGUSR1 is blocked here so
+ * every thread inherits the mask and the signal is only seen by signalfd.
+ */
+int vjoy_stats_start(const char *path) {
+    vjoy_stats_started = vjoy_stats_now();
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+    vjoy_stats_sigfd = signalfd(-1, &mask, SFD_CLOEXEC);
+    if (vjoy_stats_sigfd < 0) {
+        vjoy_log(VJOY_LOG_ERROR, "Failed to watch for SIGUSR1: %s", strerror(errno));
+        return -1;
+    }
+
+    // Stats socket, $XDG_RUNTIME_DIR/vjoy.stats unless told otherwise
+    if (path == NULL) {
+        const char *rundir = getenv("XDG_RUNTIME_DIR");
+        if (rundir != NULL) {
+            snprintf(vjoy_stats_path, sizeof(vjoy_stats_path), "%s/vjoy.stats", rundir);
+        } else {
+            snprintf(vjoy_stats_path, sizeof(vjoy_stats_path), "/tmp/vjoy-%i.stats", (int)getuid());
+        }
+    } else if (path[0] != '\0') {
+        snprintf(vjoy_stats_path, sizeof(vjoy_stats_path), "%s", path);
+    }
+    if (vjoy_stats_path[0] != '\0') {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(struct sockaddr_un));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, vjoy_stats_path, sizeof(addr.sun_path) - 1);
+        unlink(vjoy_stats_path);
+        vjoy_stats_listenfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        // Module names and timings are nobody else's business
+        if (vjoy_stats_listenfd < 0 ||
+            bind(vjoy_stats_listenfd, (struct sockaddr*)&addr, sizeof(struct sockaddr_un)) < 0 ||
+            chmod(vjoy_stats_path, 0600) < 0 ||
+            listen(vjoy_stats_listenfd, 4) < 0) {
+            vjoy_log(VJOY_LOG_WARN, "Stats socket %s unavailable: %s", vjoy_stats_path, strerror(errno));
+            if (vjoy_stats_listenfd >= 0) close(vjoy_stats_listenfd);
+            vjoy_stats_listenfd = -1;
+        } else {
+            vjoy_log(VJOY_LOG_INFO, "Serving stats on %s", vjoy_stats_path);
+            atexit(vjoy_stats_unlink);
+        }
+    }
+
+    if (pthread_create(&vjoy_stats_thread, NULL, vjoy_stats_loop, NULL) != 0) {
+        vjoy_log(VJOY_LOG_ERROR, "Failed to start stats thread.");
+        return -1;
+    }
+    return 0;
+}
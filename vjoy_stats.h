@@ -0,0 +1,52 @@
+#ifndef _VJOY_STATS_H
+#define _VJOY_STATS_H
+
+#include <time.h>
+
+#define VJOY_HIST_SUB_BITS  4  // Linear sub-buckets per power of two, as 1 << bits
+#define VJOY_HIST_MAG_MAX   40 // Largest power of two tracked (ns), about 18 minutes
+#define VJOY_HIST_BUCKETS   ((VJOY_HIST_MAG_MAX - VJOY_HIST_SUB_BITS + 2) << VJOY_HIST_SUB_BITS)
+
+/* HDR-style log-linear latency histogram in nanoseconds.  Every bucket is
+ * within 1/16th of its value, whatever the magnitude.  Written by the one
+ * reactor thread owning the device and read racily by the stats thread.
+ */
+typedef struct _vjoy_hist {
+    unsigned long      count;
+    unsigned long long sum;
+    unsigned long long max;
+    unsigned long      buckets[VJOY_HIST_BUCKETS];
+} vjoy_hist;
+
+typedef struct _vjoy_dev_stats {
+    unsigned long ticks;      // think() calls
+    unsigned long eventsin;   // Events read from uinput
+    unsigned long eventsout;  // Events written to uinput
+    unsigned long syscalls;   // read()/write()/ioctl() calls on the hot path
+    unsigned long ffuploads;  // UI_FF_UPLOAD requests served
+    unsigned long fferasures; // UI_FF_ERASE requests served
+    unsigned long reads;      // doVJoyRead() calls for watched descriptors
+    unsigned long shmevents;  // Events taken from the shared memory ring
+    unsigned long sourceevents; // Events read from physical sources
+    vjoy_hist     think;      // doVJoyThink() and staging its frame
+    vjoy_hist     gilwait;    // Waiting for the GIL in vjoy_py_enter()
+    vjoy_hist     ffupload;   // UI_BEGIN_FF_UPLOAD until UI_END_FF_UPLOAD
+} vjoy_dev_stats;
+
+static inline unsigned long long vjoy_stats_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Counters have a single writer, so no locked instruction is needed
+static inline void vjoy_stat_add(unsigned long *counter, unsigned long n) {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+void               vjoy_hist_record(vjoy_hist *hist, unsigned long long ns);
+unsigned long long vjoy_hist_quantile(vjoy_hist *hist, double quantile);
+int                vjoy_stats_start(const char *path);
+void               vjoy_stats_report(FILE *out);
+
+#endif /* _VJOY_STATS_H */
@@ -0,0 +1,225 @@
+#include "vjoy.h"
+#include <string.h>
+#include <math.h>
+
+/* Native transform pipeline.  Modules feed raw samples (ADC readings,
+ * button bitfields, ...) with vjoy.set_raw() and the per-axis arithmetic
+ * they used to do in Python every tick runs here instead:
+ *
+ *   axis/hat:  normalize 'in' -> deadzone -> expo or curve -> invert
+ *              -> clamp -> scale to 'out' (or quantize to -1/0/1 for hats)
+ *   button:    bit 'bit' of the raw channel, optionally inverted
+ */
+
+// Optional number from a transform entry, def when absent
+static double vjoy_transform_number(PyObject *entry, char *key, double def) {
+    PyObject *item = PyMapping_GetItemString(entry, key);
+    if (item == NULL) {
+        PyErr_Clear();
+        return def;
+    }
+    double value = PyFloat_AsDouble(item);
+    Py_DECREF(item);
+    if (PyErr_Occurred() != NULL) {
+        PyErr_Clear();
+        vjoy_log(VJOY_LOG_WARN, "Transform key '%s' must be a number.", key);
+        return def;
+    }
+    return value;
+}
+
+// Optional (low, high) pair from a transform entry
+static void vjoy_transform_range(PyObject *entry, char *key, double *lo, double *hi) {
+    PyObject *item = PyMapping_GetItemString(entry, key);
+    if (item == NULL) {
+        PyErr_Clear();
+        return;
+    }
+    double a = 0, b = 0;
+    if (PySequence_Check(item) && PySequence_Size(item) == 2) {
+        PyObject *pya = PySequence_GetItem(item, 0);
+        PyObject *pyb = PySequence_GetItem(item, 1);
+        a = pya != NULL ? PyFloat_AsDouble(pya) : 0;
+        b = pyb != NULL ? PyFloat_AsDouble(pyb) : 0;
+        Py_XDECREF(pya);
+        Py_XDECREF(pyb);
+    }
+    if (PyErr_Occurred() != NULL || a == b) {
+        PyErr_Clear();
+        vjoy_log(VJOY_LOG_WARN, "Transform key '%s' must be a (low, high) pair.", key);
+    } else {
+        *lo = a;
+        *hi = b;
+    }
+    Py_DECREF(item);
+}
+
+static void vjoy_transform_parse_axis(vjoy_transform *t, const vjoy_info *info, PyObject *entry,
+                                      int input, int code, int hat) {
+    if (t->axiscount >= VJOY_TRANSFORM_MAX) {
+        vjoy_log(VJOY_LOG_WARN, "Ignoring transform, at most %i axes are supported.", VJOY_TRANSFORM_MAX);
+        return;
+    }
+    int    i    = t->axiscount++;
+    double inlo = SHRT_MIN, inhi = SHRT_MAX;
+    double outlo = info->absinfo[code].minimum, outhi = info->absinfo[code].maximum;
+    vjoy_transform_range(entry, "in", &inlo, &inhi);
+    vjoy_transform_range(entry, "out", &outlo, &outhi);
+    double deadzone = vjoy_transform_number(entry, "deadzone", 0);
+    double expo     = vjoy_transform_number(entry, "expo", 0);
+    if (deadzone < 0 || deadzone >= 1) {
+        vjoy_log(VJOY_LOG_WARN, "Transform deadzone must be in [0, 1), ignoring it.");
+        deadzone = 0;
+    }
+    t->axisinput[i] = input;
+    t->axiscode[i]  = code;
+    t->inscale[i]   = 2.0 / (inhi - inlo);
+    t->inoffset[i]  = -(inlo + inhi) / 2.0;
+    t->deadzone[i]  = deadzone;
+    t->dzscale[i]   = 1.0 / (1.0 - deadzone);
+    t->expo[i]      = expo < 0 ? 0 : (expo > 1 ? 1 : expo);
+    t->sign[i]      = vjoy_transform_number(entry, "invert", 0) != 0 ? -1.0f : 1.0f;
+    t->outoffset[i] = (outlo + outhi) / 2.0;
+    t->outscale[i]  = (outhi - outlo) / 2.0;
+    t->hat[i]       = hat ? vjoy_transform_number(entry, "threshold", 0.5) : 0;
+    if (hat && t->hat[i] <= 0) {
+        t->hat[i] = 0.5;
+    }
+
+    // Response curve: output values in -1..1, evenly spaced over the input
+    t->curvelen[i]  = 0;
+    PyObject *pycurve = PyMapping_GetItemString(entry, "curve");
+    if (pycurve == NULL) {
+        PyErr_Clear();
+        return;
+    }
+    int len = PySequence_Size(pycurve);
+    if (len < 2 || len > VJOY_CURVE_MAX) {
+        vjoy_log(VJOY_LOG_WARN, "Transform curves need 2 to %i points, ignoring it.", VJOY_CURVE_MAX);
+    } else {
+        for (int p=0; p<len; p++) {
+            PyObject *pypoint = PySequence_GetItem(pycurve, p);
+            t->curve[i][p] = pypoint != NULL ? PyFloat_AsDouble(pypoint) : 0;
+            Py_XDECREF(pypoint);
+        }
+        t->curvelen[i] = len;
+        // A curve replaces expo, it can shape the response any way expo can
+        if (t->expo[i] != 0) {
+            vjoy_log(VJOY_LOG_WARN, "Transform has both 'expo' and 'curve', ignoring 'expo'.");
+            t->expo[i] = 0;
+        }
+    }
+    PyErr_Clear();
+    Py_DECREF(pycurve);
+}
+
+static void vjoy_transform_parse_button(vjoy_transform *t, PyObject *entry, int input, int code) {
+    if (t->bitcount >= VJOY_TRANSFORM_MAX) {
+        vjoy_log(VJOY_LOG_WARN, "Ignoring transform, at most %i buttons are supported.", VJOY_TRANSFORM_MAX);
+        return;
+    }
+    int bit = vjoy_transform_number(entry, "bit", 0);
+    if (bit < 0 || bit >= 32) {
+        vjoy_log(VJOY_LOG_WARN, "Ignoring button transform, bit must be in [0, 32).");
+        return;
+    }
+    int i = t->bitcount++;
+    t->bitinput[i]  = input;
+    t->bitshift[i]  = bit;
+    t->bitcode[i]   = code;
+    t->bitinvert[i] = vjoy_transform_number(entry, "invert", 0) != 0;
+}
+
+/* Compile a list of transform dicts, each with an 'input' raw channel and
+ * exactly one of 'axis', 'hat' or 'button' naming the code it drives.
+ * Axes default to the output range declared for them in 'absinfo'.
+ */
+void vjoy_transform_parse(vjoy_transform *t, const vjoy_info *info, PyObject *pytransforms) {
+    memset(t, 0, sizeof(vjoy_transform));
+    int count = PySequence_Size(pytransforms);
+    if (count < 0) {
+        PyErr_Clear();
+        vjoy_log(VJOY_LOG_WARN, "'transforms' must be a list of dicts.");
+        return;
+    }
+    for (int i=0; i<count; i++) {
+        PyObject *entry = PySequence_GetItem(pytransforms, i);
+        if (entry == NULL || !PyMapping_Check(entry)) {
+            PyErr_Clear();
+            vjoy_log(VJOY_LOG_WARN, "Ignoring transform %i, not a dict.", i);
+            Py_XDECREF(entry);
+            continue;
+        }
+        int input = vjoy_transform_number(entry, "input", -1);
+        int axis  = vjoy_transform_number(entry, "axis", -1);
+        int hat   = vjoy_transform_number(entry, "hat", -1);
+        int key   = vjoy_transform_number(entry, "button", -1);
+        if (input < 0 || input >= VJOY_RAW_MAX) {
+            vjoy_log(VJOY_LOG_WARN, "Ignoring transform %i, 'input' must be in [0, %i).", i, VJOY_RAW_MAX);
+        } else if (axis >= 0 && axis < ABS_CNT && hat < 0 && key < 0) {
+            vjoy_transform_parse_axis(t, info, entry, input, axis, 0);
+        } else if (hat >= 0 && hat < ABS_CNT && axis < 0 && key < 0) {
+            vjoy_transform_parse_axis(t, info, entry, input, hat, 1);
+        } else if (key >= 0 && key < KEY_CNT && axis < 0 && hat < 0) {
+            vjoy_transform_parse_button(t, entry, input, key);
+        } else {
+            vjoy_log(VJOY_LOG_WARN, "Ignoring transform %i, it needs exactly one of 'axis', 'hat' or 'button'.", i);
+        }
+        Py_DECREF(entry);
+    }
+}
+
+static float vjoy_transform_curve(const float *curve, int len, float x) {
+    float pos  = (x + 1.0f) * 0.5f * (len - 1);
+    int   seg  = (int)pos;
+    if (seg >= len - 1) {
+        return curve[len - 1];
+    }
+    float frac = pos - seg;
+    return curve[seg] + (curve[seg + 1] - curve[seg]) * frac;
+}
+
+// Evaluate the pipeline over the latest raw samples and stage the results
+void vjoy_transform_apply(vjoy_dev *dev) {
+    vjoy_transform *t = &dev->transform;
+    float           n[VJOY_TRANSFORM_MAX];
+    int             count = t->axiscount;
+    if (!t->dirty) {
+        return;
+    }
+    t->dirty = 0;
+
+    for (int i=0; i<count; i++) {
+        n[i] = t->raw[t->axisinput[i]];
+    }
+    // Normalize, clamp, deadzone and expo: straight-line arithmetic per axis
+    for (int i=0; i<count; i++) {
+        float x   = (n[i] + t->inoffset[i]) * t->inscale[i];
+        x         = fminf(fmaxf(x, -1.0f), 1.0f);
+        float mag = fmaxf(fabsf(x) - t->deadzone[i], 0.0f) * t->dzscale[i];
+        x         = copysignf(mag, x);
+        n[i]      = x + t->expo[i] * (x * x * x - x);
+    }
+    for (int i=0; i<count; i++) {
+        if (t->curvelen[i] > 0) {
+            n[i] = vjoy_transform_curve(t->curve[i], t->curvelen[i], n[i]);
+        }
+    }
+    for (int i=0; i<count; i++) {
+        n[i] = fminf(fmaxf(n[i] * t->sign[i], -1.0f), 1.0f);
+    }
+    for (int i=0; i<count; i++) {
+        int value;
+        if (t->hat[i] > 0) {
+            value = n[i] > t->hat[i] ? 1 : (n[i] < -t->hat[i] ? -1 : 0);
+        } else {
+            value = lrintf(t->outoffset[i] + n[i] * t->outscale[i]);
+        }
+        vjoy_dev_emit(dev, EV_ABS, t->axiscode[i], value);
+    }
+
+    for (int i=0; i<t->bitcount; i++) {
+        int value = ((unsigned)t->raw[t->bitinput[i]] >> t->bitshift[i]) & 1;
+        vjoy_dev_emit(dev, EV_KEY, t->bitcode[i], value ^ t->bitinvert[i]);
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef _VJOY_TRANSFORM_H
+#define _VJOY_TRANSFORM_H
+
+#define VJOY_RAW_MAX       64 // Raw sample channels a module can feed
+#define VJOY_TRANSFORM_MAX 64 // Axis/hat and button transforms per device
+#define VJOY_CURVE_MAX     33 // Points in a response curve table
+
+/* A device's transform pipeline, compiled from the 'transforms' entry of
+ * getVJoyInfo().  Axis and hat stages are kept as parallel arrays so each
+ * stage is one branch-free loop over every axis.
+ */
+typedef struct _vjoy_transform {
+    int   raw[VJOY_RAW_MAX];   // Latest samples from vjoy.set_raw()
+    int   dirty;               // Samples changed since the last evaluation
+
+    int   axiscount;
+    int   axisinput[VJOY_TRANSFORM_MAX];  // Raw channel
+    int   axiscode[VJOY_TRANSFORM_MAX];   // ABS_* code emitted
+    float inoffset[VJOY_TRANSFORM_MAX];   // Raw -> -1..1: (raw + inoffset) * inscale
+    float inscale[VJOY_TRANSFORM_MAX];
+    float deadzone[VJOY_TRANSFORM_MAX];   // Fraction of the range around center
+    float dzscale[VJOY_TRANSFORM_MAX];    // 1 / (1 - deadzone)
+    float expo[VJOY_TRANSFORM_MAX];       // 0 linear .. 1 cubic
+    float sign[VJOY_TRANSFORM_MAX];       // -1 when inverted
+    float outoffset[VJOY_TRANSFORM_MAX];  // -1..1 -> output: outoffset + n * outscale
+    float outscale[VJOY_TRANSFORM_MAX];
+    float hat[VJOY_TRANSFORM_MAX];        // Threshold of an axis -> hat mapping, 0 for axes
+    int   curvelen[VJOY_TRANSFORM_MAX];   // Points in curve, 0 for none
+    float curve[VJOY_TRANSFORM_MAX][VJOY_CURVE_MAX];
+
+    int   bitcount;
+    int   bitinput[VJOY_TRANSFORM_MAX];
+    int   bitshift[VJOY_TRANSFORM_MAX];
+    int   bitcode[VJOY_TRANSFORM_MAX];    // KEY_*/BTN_* code emitted
+    int   bitinvert[VJOY_TRANSFORM_MAX];
+} vjoy_transform;
+
+struct _vjoy_dev;
+struct _vjoy_info;
+
+void vjoy_transform_parse(vjoy_transform *transform, const struct _vjoy_info *info, PyObject *pytransforms);
+void vjoy_transform_apply(struct _vjoy_dev *dev);
+
+#endif /* _VJOY_TRANSFORM_H */